@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Runs KrazyKarts under simulated network conditions and reports prediction quality.
+
+For every profile a dedicated server and N clients are launched on this machine over
+loopback with packet lag, jitter and loss applied through the engine's packet simulation
+(-PktLag, -PktLagVariance, -PktLoss). Clients drive with kk.Test.ScriptedInput so runs are
+repeatable, and log a KartNetStats line once a second (kk.Net.LogReconciliation). Those
+lines are summed per profile into corrections, mean/max position error, pending move depth
+and bytes sent.
+
+Example:
+    python Scripts/RunNetScenarios.py --engine "C:/UE_4.27/Engine/Binaries/Win64/UE4Editor.exe" --clients 4
+"""
+
+import argparse
+import csv
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+# name, round trip lag ms, lag variance ms, loss percent
+DEFAULT_PROFILES = [
+    ("lan", 0, 0, 0),
+    ("broadband", 60, 10, 0),
+    ("wifi", 80, 40, 1),
+    ("mobile", 150, 60, 3),
+    ("bad", 250, 100, 10),
+]
+
+STATS_PATTERN = re.compile(r"KartNetStats: (.*)")
+
+
+def parse_profile(text):
+    name, lag, variance, loss = text.split(":")
+    return name, int(lag), int(variance), int(loss)
+
+
+def packet_args(lag, variance, loss):
+    # Packet simulation only delays outgoing packets, so split the round trip over both ends
+    return ["-PktLag=%d" % (lag // 2), "-PktLagVariance=%d" % (variance // 2), "-PktLoss=%d" % loss]
+
+
+def launch(args, extra, log_path):
+    command = [args.engine, os.path.abspath(args.project)] + extra + [
+        "-log", "-abslog=%s" % log_path, "-unattended", "-nosplash", "-nosound", "-NullRHI", "-NoVerifyGC",
+    ]
+    return subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def stop(processes):
+    for process in processes:
+        if process.poll() is None:
+            process.terminate()
+    for process in processes:
+        try:
+            process.wait(timeout=15)
+        except subprocess.TimeoutExpired:
+            process.kill()
+
+
+def read_stats(log_path, warmup):
+    """Returns the KartNetStats lines of one client log as dicts, skipping the first warmup seconds."""
+    samples = []
+    elapsed = 0.0
+    if not os.path.exists(log_path):
+        return samples
+    with open(log_path, encoding="utf-8", errors="replace") as log:
+        for line in log:
+            match = STATS_PATTERN.search(line)
+            if not match:
+                continue
+            sample = dict(field.split("=", 1) for field in match.group(1).split())
+            elapsed += float(sample["Seconds"])
+            if elapsed > warmup:
+                samples.append(sample)
+    return samples
+
+
+def summarize(name, lag, variance, loss, client_samples):
+    samples = [sample for samples in client_samples for sample in samples]
+    seconds = sum(float(s["Seconds"]) for s in samples)
+    states = sum(int(s["States"]) for s in samples)
+    errors = [(float(s["ErrorMean"]), int(s["States"])) for s in samples if int(s["States"]) > 0]
+    weight = sum(count for _, count in errors)
+    return {
+        "profile": name,
+        "lag_ms": lag,
+        "jitter_ms": variance,
+        "loss_pct": loss,
+        "clients_reporting": sum(1 for samples in client_samples if samples),
+        "seconds": round(seconds, 1),
+        "corrections": sum(int(s["Corrections"]) for s in samples),
+        "corrections_per_s": round(sum(int(s["Corrections"]) for s in samples) / seconds, 2) if seconds else 0,
+        "skipped": sum(int(s["Skipped"]) for s in samples),
+        "replayed_moves": sum(int(s["Replayed"]) for s in samples),
+        "error_mean_cm": round(sum(mean * count for mean, count in errors) / weight, 3) if weight else 0,
+        "error_max_cm": round(max((float(s["ErrorMax"]) for s in samples), default=0.0), 3),
+        "unacked_mean": round(sum(float(s["UnackedMean"]) * int(s["States"]) for s in samples) / states, 2) if states else 0,
+        "unacked_max": max((int(s["UnackedMax"]) for s in samples), default=0),
+        "client_out_bytes_per_s": round(sum(int(s["OutBytes"]) for s in samples) / seconds) if seconds else 0,
+        "client_in_bytes_per_s": round(sum(int(s["InBytes"]) for s in samples) / seconds) if seconds else 0,
+        "send_rate_hz": round(sum(float(s.get("SendRate", 0)) * float(s["Seconds"]) for s in samples) / seconds, 1) if seconds else 0,
+        "send_rate_min_hz": round(min((float(s["SendRate"]) for s in samples if "SendRate" in s), default=0.0), 1),
+        "rtt_ms": round(sum(float(s.get("RttMs", 0)) * float(s["Seconds"]) for s in samples) / seconds, 1) if seconds else 0,
+    }
+
+
+def run_profile(args, profile, log_dir):
+    name, lag, variance, loss = profile
+    port = args.port
+    cvars = "-dpcvars=kk.Test.ScriptedInput=%d,kk.Net.LogReconciliation=1" % args.seed
+
+    server_log = os.path.join(log_dir, "%s_server.log" % name)
+    processes = [launch(args, [args.map, "-server", "-port=%d" % port] + packet_args(lag, variance, loss), server_log)]
+    time.sleep(args.server_startup)
+
+    client_logs = []
+    try:
+        for index in range(args.clients):
+            client_log = os.path.join(log_dir, "%s_client%d.log" % (name, index))
+            client_logs.append(client_log)
+            processes.append(launch(args, ["127.0.0.1:%d" % port, "-game", "-windowed", "-ResX=320", "-ResY=240", cvars] + packet_args(lag, variance, loss), client_log))
+        time.sleep(args.warmup + args.duration)
+    finally:
+        stop(processes)
+
+    return summarize(name, lag, variance, loss, [read_stats(log, args.warmup) for log in client_logs])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--engine", required=True, help="UE4Editor binary, or a packaged KrazyKarts executable")
+    parser.add_argument("--project", default=os.path.join(os.path.dirname(__file__), "..", "KrazyKarts.uproject"))
+    parser.add_argument("--map", default="/Game/VehicleCPP/Maps/VehicleExampleMap")
+    parser.add_argument("--clients", type=int, default=2)
+    parser.add_argument("--duration", type=float, default=60, help="seconds measured per profile")
+    parser.add_argument("--warmup", type=float, default=10, help="seconds after the clients start that are not measured")
+    parser.add_argument("--server-startup", type=float, default=15, help="seconds to wait for the server before starting clients")
+    parser.add_argument("--port", type=int, default=7777)
+    parser.add_argument("--seed", type=int, default=1, help="kk.Test.ScriptedInput value")
+    parser.add_argument("--profile", action="append", type=parse_profile, metavar="NAME:LAG:JITTER:LOSS",
+                        help="replaces the default profiles, may be repeated")
+    parser.add_argument("--log-dir", help="where to keep server and client logs, defaults to a temporary directory")
+    parser.add_argument("--csv", help="also write the results to this file")
+    args = parser.parse_args()
+
+    log_dir = args.log_dir or tempfile.mkdtemp(prefix="KrazyKartsNet")
+    os.makedirs(log_dir, exist_ok=True)
+
+    results = []
+    for profile in args.profile or DEFAULT_PROFILES:
+        print("Running %s (%d ms, +-%d ms, %d%% loss) with %d clients..." % (profile + (args.clients,)), flush=True)
+        results.append(run_profile(args, profile, log_dir))
+
+    columns = list(results[0].keys())
+    widths = [max(len(column), *(len(str(result[column])) for result in results)) for column in columns]
+    print()
+    print("  ".join(column.rjust(width) for column, width in zip(columns, widths)))
+    for result in results:
+        print("  ".join(str(result[column]).rjust(width) for column, width in zip(columns, widths)))
+    print("\nLogs in %s" % log_dir)
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as output:
+            writer = csv.DictWriter(output, fieldnames=columns)
+            writer.writeheader()
+            writer.writerows(results)
+
+    return 0 if all(result["clients_reporting"] == args.clients for result in results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -2,11 +2,78 @@
 #include "GoKart.h"
 
 #include "Components/InputComponent.h"
+#include "Components/PrimitiveComponent.h"
 #include "Engine/EngineTypes.h"
 #include "Math/Quat.h"
-#include "DrawDebugHelpers.h"
 #include "Net/UnrealNetwork.h"
-#include "Algo/RemoveIf.h"
+#include "Engine/NetConnection.h"
+#include "GoKartNetSerialization.h"
+#include "KrazyKarts.h"
+#include "KrazyKartsServerStats.h"
+#include "GoKartSimulationSubsystem.h"
+#include "GoKartMoveRecorder.h"
+#include "GoKartLagCompensationSubsystem.h"
+#include "GoKartTrackCollisionSubsystem.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	// Most moves in one Server_SendMoves call; a longer backlog is split over several
+	constexpr int32 MaxMovesPerSend = 32;
+
+	// Server states kept per simulated proxy for interpolation
+	constexpr int32 MaxSnapshots = 32;
+
+	// Fixed rate moves simulated in one frame at most; time beyond that is dropped rather than caught up on
+	constexpr int32 MaxFixedStepsPerFrame = 8;
+
+	// Validated client moves waiting for the server tick, per kart; the oldest are dropped beyond this
+	constexpr int32 MaxServerMoveQueue = 128;
+
+	// Move time credit refills this much faster than server time, so a client clock running slightly fast isn't clamped
+	constexpr float MoveTimeCreditSlack = 0.02f;
+
+	TAutoConsoleVariable<float> CVarMaxMoveDeltaTime(
+		TEXT("kk.Net.MaxMoveDeltaTime"),
+		0.25f,
+		TEXT("Longest DeltaTime the server accepts in a client move, in seconds. Longer moves are clamped."));
+
+	TAutoConsoleVariable<float> CVarMaxMoveRate(
+		TEXT("kk.Net.MaxMoveRate"),
+		500.f,
+		TEXT("Most moves per second the server accepts from one client. Moves beyond it are dropped."));
+
+	TAutoConsoleVariable<float> CVarMoveTimeCredit(
+		TEXT("kk.Net.MoveTimeCredit"),
+		0.5f,
+		TEXT("Seconds of move time and of the move rate a client may bank, to deliver moves held up by a late or lost packet. Move time claimed beyond the server time passed and this is clamped."));
+
+	TAutoConsoleVariable<int32> CVarLogReconciliation(
+		TEXT("kk.Net.LogReconciliation"),
+		0,
+		TEXT("Log a KartNetStats line once a second for locally controlled karts: corrections, prediction error, pending moves and bytes. Parsed by Scripts/RunNetScenarios.py."));
+
+	TAutoConsoleVariable<int32> CVarScriptedInput(
+		TEXT("kk.Test.ScriptedInput"),
+		0,
+		TEXT("Drive locally controlled karts with a repeatable throttle and steering pattern instead of player input. The value seeds the pattern."));
+}
+
+DECLARE_CYCLE_STAT(TEXT("SimulateMove"), STAT_GoKartSimulateMove, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("SimulateMove Rotation Sweep"), STAT_GoKartRotationSweep, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("SimulateMove Location Sweep"), STAT_GoKartLocationSweep, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("Track Collision Sweep"), STAT_GoKartTrackSweep, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("OnRep_ServerState"), STAT_GoKartOnRepServerState, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("Replay Pending Moves"), STAT_GoKartReplayPendingMoves, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("ClearAknowledgeMoves"), STAT_GoKartClearAknowledgeMoves, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("Server_SendMoves"), STAT_GoKartServerSendMoves, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Server Moves Dropped"), STAT_GoKartServerMovesDropped, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Server Moves Clamped"), STAT_GoKartServerMovesClamped, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("ApplyBatchedMoves"), STAT_GoKartApplyBatchedMoves, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Batched Moves Reswept"), STAT_GoKartBatchResweeps, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corrections"), STAT_GoKartCorrections, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Replayed Moves"), STAT_GoKartReplayedMoves, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Server Moves Received"), STAT_GoKartServerMovesReceived, STATGROUP_KrazyKarts);
 
 // Sets default values
 AGoKart::AGoKart()
@@ -15,40 +82,73 @@ AGoKart::AGoKart()
 	PrimaryActorTick.bCanEverTick = true;
 	bReplicates = true;
 
-	if (HasAuthority())
-	{
-		NetUpdateFrequency = 1;
-	}
+	// Upper bound; UGoKartReplicationGraph lowers it per connection for distant karts
+	NetUpdateFrequency = 30.f;
 }
 
 // Called when the game starts or when spawned
 void AGoKart::BeginPlay()
 {
 	Super::BeginPlay();
-	
-}
 
-void AGoKart::GetLifetimeReplicatedProps(TArray< FLifetimeProperty >& OutLifetimeProps) const
-{
-	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	DOREPLIFETIME(AGoKart, ServerState);
+	ServerStats = GetWorld()->GetSubsystem<UKrazyKartsServerStats>();
+
+	UGoKartTrackCollisionSubsystem* TrackCollisionSubsystem = GetWorld()->GetSubsystem<UGoKartTrackCollisionSubsystem>();
+	UPrimitiveComponent* Root = Cast<UPrimitiveComponent>(GetRootComponent());
+	if (TrackCollisionSubsystem && TrackCollisionSubsystem->IsLoaded() && Root)
+	{
+		// Karts turn about Z, so the track sees the kart's longer half-length on both horizontal axes
+		TrackCollision = TrackCollisionSubsystem;
+		TrackCollision->IgnoreBakedComponents(Root);
+		const FVector Extent{ Root->GetCollisionShape().GetExtent() };
+		TrackCollisionExtent = FVector(FMath::Max(Extent.X, Extent.Y), FMath::Max(Extent.X, Extent.Y), Extent.Z);
+	}
+
+	if (HasAuthority())
+	{
+		SimulationSubsystem = GetWorld()->GetSubsystem<UGoKartSimulationSubsystem>();
+		if (SimulationSubsystem)
+		{
+			SimulationSubsystem->Register(this);
+		}
+		ServerMoveQueue.Init(MaxServerMoveQueue);
+		MoveRecorder = GetWorld()->GetSubsystem<UGoKartMoveRecorder>();
+		LagCompensation = GetWorld()->GetSubsystem<UGoKartLagCompensationSubsystem>();
+		if (LagCompensation)
+		{
+			LagCompensation->Register(this);
+		}
+	}
 }
 
-FString GetRoleAsString(ENetRole inRole)
+void AGoKart::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	switch (inRole)
+	if (SimulationSubsystem)
 	{
-	case ROLE_None:
-		return "None";
-	case ROLE_SimulatedProxy:
-		return "SimulatedProxy";
-	case ROLE_AutonomousProxy:
-		return "AutonomousProxy";
-	case ROLE_Authority:
-		return "Authority";
-	default:
-		return "ERROR!";
+		SimulationSubsystem->Unregister(this);
 	}
+	if (LagCompensation)
+	{
+		LagCompensation->Unregister(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AGoKart::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	UnackowledgedMoves.Init(MaxUnacknowledgedMoves);
+	Snapshots.Init(MaxSnapshots);
+	SendRateController.Init(MinMoveSendRate, MoveSendRate, MoveRedundancy);
+	SimConstants = FGoKartSimConstants::Make(GetSimParams());
+}
+
+void AGoKart::GetLifetimeReplicatedProps(TArray< FLifetimeProperty >& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AGoKart, ServerState);
 }
 
 // Called every frame
@@ -56,110 +156,384 @@ void AGoKart::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	SimConstants = FGoKartSimConstants::Make(GetSimParams());
+
+	if (IsLocallyControlled() && CVarScriptedInput.GetValueOnGameThread() != 0)
+	{
+		ApplyScriptedInput();
+	}
 
 	if (GetLocalRole() == ROLE_AutonomousProxy)
 	{
-		FGoKartMove CurrentMove{ CreateMove(DeltaTime) };
-		SimulateMove(CurrentMove);
-		UnackowledgedMoves.Add(CurrentMove);
-		Server_SendMove(CurrentMove);
+		if (FixedSimulationRate > 0.f)
+		{
+			TickFixedSimulation(DeltaTime);
+		}
+		else
+		{
+			PredictMove(DeltaTime);
+		}
+
+		UpdateSendRate(DeltaTime);
+		TimeSinceMovesSent += DeltaTime;
+		const float SendRate = GetMoveSendRate();
+		const float SendInterval = SendRate > 0.f ? 1.f / SendRate : 0.f;
+		// At a fixed simulation rate a frame may produce no new move to send
+		if (TimeSinceMovesSent >= SendInterval && MovesSinceLastSend > 0)
+		{
+			TimeSinceMovesSent = FMath::Min(TimeSinceMovesSent - SendInterval, SendInterval);
+			SendMoves();
+		}
 	}
 	else if (GetLocalRole() == ROLE_Authority && GetRemoteRole() == ROLE_SimulatedProxy)
 	{
 		// We are the server and in control of the pawn
 		FGoKartMove CurrentMove{ CreateMove(DeltaTime) };
-		Server_SendMove(CurrentMove);
+		ReceiveMove(CurrentMove);
 	}
 	else if (GetLocalRole() == ROLE_SimulatedProxy)
 	{
-		SimulateMove(ServerState.LastMove);
+		InterpolateSnapshots();
 	}
 
-	DrawDebugString(GetWorld(), FVector(0.f, 0.f, 100.f), GetRoleAsString(GetLocalRole()), this, FColor::White, DeltaTime);
+	FGoKartBandwidthStats::ReportIfDue(GetWorld());
 }
 
 void AGoKart::SimulateMove(const FGoKartMove& Move)
 {
-	FVector Force = GetActorForwardVector() * MaxDrivingForce * Move.Throttle;
-	Force += GetAirResistance();
-	Force += GetRollingResistance();
+	SCOPE_CYCLE_COUNTER(STAT_GoKartSimulateMove);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, SimulateMove);
 
-	FVector Acceleration = Force / Mass;
-	Velocity += Acceleration * Move.DeltaTime;
+	const FQuat Rotation{ GetActorQuat() };
+	FQuat RotationDelta;
+	FVector DeltaLocation;
+	GoKartSimulation::IntegrateMove(SimConstants, Rotation.GetForwardVector(), Rotation.GetUpVector(), Move, Velocity, RotationDelta, DeltaLocation);
 
-	UpdateRotation(Move.DeltaTime, Move.Steering);
-	UpdateLocationFromVelocity(Move.DeltaTime);
+	UpdateRotation(RotationDelta);
+	UpdateLocation(DeltaLocation);
 }
 
 FGoKartMove AGoKart::CreateMove(float DeltaTime)
 {
 	FGoKartMove NewMove;
-	NewMove.DeltaTime = DeltaTime;
+	NewMove.DeltaTime = DeltaTime + DeltaTimeRemainder;
 	NewMove.Throttle = Throttle;
 	NewMove.Steering = Steering;
 	NewMove.TimeStamp = GetWorld()->TimeSeconds;
+	NewMove.Sequence = NextMoveSequence++;
+	NewMove.Quantize();
+	DeltaTimeRemainder = DeltaTime + DeltaTimeRemainder - NewMove.DeltaTime;
 	
 	return NewMove;
 }
 
+void AGoKart::PredictMove(float DeltaTime)
+{
+	FGoKartMove CurrentMove{ CreateMove(DeltaTime) };
+	SimulateMove(CurrentMove);
+	if (!UnackowledgedMoves.Push({ CurrentMove, GetSimState() }))
+	{
+		// Server has stopped acking; keep predicting but lose the ability to replay the oldest moves
+		UE_CLOG(NumDroppedMoves == 0, LogKrazyKarts, Warning, TEXT("%s: unacknowledged move buffer full (%d), dropping oldest moves"), *GetName(), UnackowledgedMoves.Capacity());
+		++NumDroppedMoves;
+	}
+	++MovesSinceLastSend;
+}
+
+void AGoKart::TickFixedSimulation(float DeltaTime)
+{
+	// Put the kart back where the simulation left it before moving it any further
+	if (bShowingRenderState)
+	{
+		SetActorLocationAndRotation(LastSimState.Location, LastSimState.Rotation);
+		bShowingRenderState = false;
+	}
+	else
+	{
+		// First fixed step, or a correction moved the kart since
+		PreviousSimState = GetSimState();
+	}
+
+	const float StepTime = 1.f / FixedSimulationRate;
+	SimAccumulator += DeltaTime;
+	for (int32 Step = 0; Step < MaxFixedStepsPerFrame && SimAccumulator >= StepTime; ++Step)
+	{
+		PreviousSimState = GetSimState();
+		PredictMove(StepTime);
+		SimAccumulator -= StepTime;
+	}
+	SimAccumulator = FMath::Fmod(SimAccumulator, StepTime);
+
+	// Draw the kart between the last two simulated states, as far as the unsimulated time reaches
+	LastSimState = GetSimState();
+	const float Alpha = SimAccumulator / StepTime;
+	SetActorLocationAndRotation(FMath::Lerp(PreviousSimState.Location, LastSimState.Location, Alpha),
+		FQuat::Slerp(PreviousSimState.Rotation, LastSimState.Rotation, Alpha));
+	bShowingRenderState = true;
+}
+
 void AGoKart::ClearAknowledgeMoves(const FGoKartMove& inLastMove)
 {
-	//if (!HasAuthority())
+	SCOPE_CYCLE_COUNTER(STAT_GoKartClearAknowledgeMoves);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, ClearAknowledgeMoves);
+
+	// Buffered moves have consecutive sequence numbers, so acking is a head advance
+	if (!UnackowledgedMoves.IsEmpty())
 	{
-		UnackowledgedMoves.SetNum(Algo::RemoveIf(UnackowledgedMoves, [&inLastMove](FGoKartMove curMove)
-			{
-				return curMove.TimeStamp <= inLastMove.TimeStamp;
-			}));
+		const int64 NumAcknowledged = int64(inLastMove.Sequence) - UnackowledgedMoves[0].Move.Sequence + 1;
+		UnackowledgedMoves.PopFront(int32(FMath::Clamp<int64>(NumAcknowledged, 0, UnackowledgedMoves.Num())));
 	}
+	NumDroppedMoves = 0;
+}
+
+const FGoKartPendingMove* AGoKart::FindPendingMove(uint32 Sequence) const
+{
+	if (UnackowledgedMoves.IsEmpty())
+	{
+		return nullptr;
+	}
+	const int64 Index = int64(Sequence) - UnackowledgedMoves[0].Move.Sequence;
+	return Index >= 0 && Index < UnackowledgedMoves.Num() ? &UnackowledgedMoves[int32(Index)] : nullptr;
+}
+
+bool AGoKart::IsWithinErrorThreshold(const FGoKartSimState& Predicted) const
+{
+	return FVector::DistSquared(Predicted.Location, ServerState.Transform.GetLocation()) <= FMath::Square(MaxLocationError)
+		&& FVector::DistSquared(Predicted.Velocity, ServerState.Velocity) <= FMath::Square(MaxVelocityError)
+		&& Predicted.Rotation.AngularDistance(ServerState.Transform.GetRotation()) <= MaxRotationError;
 }
 
 void AGoKart::OnRep_ServerState()
 {
+	SCOPE_CYCLE_COUNTER(STAT_GoKartOnRepServerState);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, OnRepServerState);
+
+	if (GetLocalRole() == ROLE_SimulatedProxy)
+	{
+		AddSnapshot();
+		return;
+	}
+
+	++NumServerStates;
+	const FGoKartPendingMove* AckedMove = FindPendingMove(ServerState.LastMove.Sequence);
+	if (AckedMove)
+	{
+		const float PositionError = FVector::Dist(AckedMove->PredictedState.Location, ServerState.Transform.GetLocation());
+		SumPositionError += PositionError;
+		MaxPositionError = FMath::Max(MaxPositionError, PositionError);
+		++NumPositionErrors;
+
+		if (AckedMove->SentTime >= 0.f)
+		{
+			SendRateController.AddAckLatency(GetWorld()->GetTimeSeconds() - AckedMove->SentTime);
+		}
+	}
+
+	if (ReconcileMode == EGoKartReconcileMode::Thresholded)
+	{
+		if (AckedMove && IsWithinErrorThreshold(AckedMove->PredictedState))
+		{
+			// Our prediction agrees with the server, so the pending moves are still valid as simulated
+			ClearAknowledgeMoves(ServerState.LastMove);
+			++NumSkippedCorrections;
+			ReportReconcileStats();
+			return;
+		}
+	}
+
+	++NumCorrections;
+	INC_DWORD_STAT(STAT_GoKartCorrections);
+	CSV_CUSTOM_STAT(KrazyKarts, Corrections, 1, ECsvCustomStatOp::Accumulate);
+	ClearAknowledgeMoves(ServerState.LastMove);
+	const FVector LocationBeforeCorrection{ GetActorLocation() };
 	SetActorTransform(ServerState.Transform);
 	Velocity = ServerState.Velocity;
-	ClearAknowledgeMoves(ServerState.LastMove);
 
-	for (const FGoKartMove& CurMove : UnackowledgedMoves)
+	if (ReconcileMode == EGoKartReconcileMode::Thresholded)
+	{
+		ReplayPendingMoves();
+	}
+	else
+	{
+		for (int32 Index = 0; Index < UnackowledgedMoves.Num(); ++Index)
+		{
+			FGoKartPendingMove& PendingMove = UnackowledgedMoves[Index];
+			SimulateMove(PendingMove.Move);
+			PendingMove.PredictedState = GetSimState();
+		}
+	}
+	// The kart is now at its simulated state, which the next fixed step starts from
+	bShowingRenderState = false;
+	LastCorrectionDistance = FVector::Dist(LocationBeforeCorrection, GetActorLocation());
+	LastCorrectionTime = GetWorld()->GetTimeSeconds();
+	NumReplayedMoves += UnackowledgedMoves.Num();
+	INC_DWORD_STAT_BY(STAT_GoKartReplayedMoves, UnackowledgedMoves.Num());
+	CSV_CUSTOM_STAT(KrazyKarts, ReplayedMoves, UnackowledgedMoves.Num(), ECsvCustomStatOp::Accumulate);
+	ReportReconcileStats();
+}
+
+void AGoKart::ReplayPendingMoves()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartReplayPendingMoves);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, ReplayPendingMoves);
+
+	// Replay without collision from the server state, then cover the whole path with one sweep
+	const FGoKartSimState Start{ GetSimState() };
+	FGoKartSimState State{ Start };
+	for (int32 Index = 0; Index < UnackowledgedMoves.Num(); ++Index)
+	{
+		FGoKartPendingMove& PendingMove = UnackowledgedMoves[Index];
+		State = GoKartSimulation::Step(State, PendingMove.Move, SimConstants);
+		PendingMove.PredictedState = State;
+	}
+
+	if (UnackowledgedMoves.IsEmpty())
+	{
+		return;
+	}
+
+	SetActorRotation(State.Rotation);
+	Velocity = State.Velocity;
+	if (SweepLocation(State.Location - Start.Location))
+	{
+		Velocity = FVector::ZeroVector;
+		UnackowledgedMoves.Last().PredictedState = GetSimState();
+	}
+}
+
+void AGoKart::AddSnapshot()
+{
+	Velocity = ServerState.Velocity;
+	Snapshots.Add(ServerState.LastMove.TimeStamp, GetWorld()->GetTimeSeconds(),
+		ServerState.Transform.GetLocation(), ServerState.Transform.GetRotation(), ServerState.Velocity);
+}
+
+float AGoKart::GetSnapshotInterpolationDelay() const
+{
+	// Update rates differ per connection, so by default the delay follows the rate we actually receive.
+	// The server receives no snapshots and assumes the full update rate.
+	const float UpdateInterval = Snapshots.GetAverageInterval() > 0.f ? Snapshots.GetAverageInterval() : 1.f / FMath::Max(NetUpdateFrequency, 1.f);
+	return SnapshotInterpolationDelay > 0.f ? SnapshotInterpolationDelay : 1.5f * UpdateInterval;
+}
+
+void AGoKart::InterpolateSnapshots()
+{
+	FVector Location;
+	FQuat Rotation;
+	if (Snapshots.Sample(GetWorld()->GetTimeSeconds(), GetSnapshotInterpolationDelay(), Location, Rotation))
+	{
+		// Remote karts only follow the server, so no sweep is needed
+		SetActorLocationAndRotation(Location, Rotation);
+	}
+}
+
+void AGoKart::ReportReconcileStats()
+{
+	SumUnacknowledgedMoves += UnackowledgedMoves.Num();
+	MaxUnacknowledgedMovesSeen = FMath::Max(MaxUnacknowledgedMovesSeen, UnackowledgedMoves.Num());
+
+	const double CurrentTime = FPlatformTime::Seconds();
+	const double Elapsed = CurrentTime - ReconcileStatsStartTime;
+	if (Elapsed < 1.0)
 	{
-		SimulateMove(CurMove);
+		return;
 	}
+
+	const UNetConnection* Connection = GetNetConnection();
+	const uint64 InBytes = Connection ? Connection->InTotalBytes : 0;
+	const uint64 OutBytes = Connection ? Connection->OutTotalBytes : 0;
+
+	// Keep the key=value layout stable, Scripts/RunNetScenarios.py parses it
+	UE_CLOG(CVarLogReconciliation.GetValueOnGameThread() != 0, LogKrazyKarts, Display,
+		TEXT("KartNetStats: Kart=%s Seconds=%.2f States=%d Corrections=%d Skipped=%d Replayed=%d ErrorMean=%.3f ErrorMax=%.3f UnackedMean=%.2f UnackedMax=%d InBytes=%llu OutBytes=%llu SendRate=%.1f Redundancy=%d RttMs=%.1f AckMs=%.1f QueueDelayMs=%.1f Saturation=%.3f"),
+		*GetName(), Elapsed, NumServerStates, NumCorrections, NumSkippedCorrections, NumReplayedMoves,
+		NumPositionErrors > 0 ? SumPositionError / NumPositionErrors : 0.f, MaxPositionError,
+		NumServerStates > 0 ? float(SumUnacknowledgedMoves) / NumServerStates : 0.f, MaxUnacknowledgedMovesSeen,
+		InBytes - ReconcileStatsStartInBytes, OutBytes - ReconcileStatsStartOutBytes,
+		GetMoveSendRate(), GetMoveRedundancy(), SendRateController.GetRoundTripTime() * 1000.f,
+		SendRateController.GetAckLatency() * 1000.f, SendRateController.GetQueueDelay() * 1000.f, SendRateController.GetSaturation());
+
+	NumCorrections = NumSkippedCorrections = NumReplayedMoves = NumServerStates = NumPositionErrors = 0;
+	SumPositionError = MaxPositionError = 0.f;
+	SumUnacknowledgedMoves = MaxUnacknowledgedMovesSeen = 0;
+	ReconcileStatsStartInBytes = InBytes;
+	ReconcileStatsStartOutBytes = OutBytes;
+	ReconcileStatsStartTime = CurrentTime;
 }
 
-FVector AGoKart::GetRollingResistance()
+void AGoKart::ApplyScriptedInput()
 {
-	float AccelerationDueToGravity = -GetWorld()->GetGravityZ() / 100.f;
-	float NormalForceAcceleration = Mass * AccelerationDueToGravity;
-	FVector Resistance = -Velocity.GetSafeNormal() * RollingResistanceCoefficient * NormalForceAcceleration;
-	return Resistance;
+	// Full throttle with a short brake every 10 s, weaving at two frequencies so the path covers
+	// straights and tight turns. Offset per kart so clients do not drive in formation.
+	const uint32 Seed = CVarScriptedInput.GetValueOnGameThread();
+	const float Time = GetWorld()->GetTimeSeconds() + (GetTypeHash(GetName()) ^ Seed) % 1000 * 0.1f;
+	Throttle = FMath::Fmod(Time, 10.f) < 8.5f ? 1.f : -1.f;
+	Steering = FMath::Sin(Time * 0.9f) * FMath::Sin(Time * 0.23f);
 }
 
-FVector AGoKart::GetAirResistance()
+FGoKartSimParams AGoKart::GetSimParams() const
 {
-	FVector Resistance;
-	Resistance = - Velocity.GetSafeNormal() *  Velocity.SizeSquared() * DragCoefficient;
-	return Resistance;
+	FGoKartSimParams Params;
+	Params.Mass = Mass;
+	Params.MaxDrivingForce = MaxDrivingForce;
+	Params.MinTurningRadius = MinTurningRadius;
+	Params.DragCoefficient = DragCoefficient;
+	Params.RollingResistanceCoefficient = RollingResistanceCoefficient;
+	Params.GravityZ = GetWorld()->GetGravityZ();
+	return Params;
 }
 
-void AGoKart::UpdateRotation(const float DeltaTime, const float inSteering)
+FGoKartSimState AGoKart::GetSimState() const
 {
-	float DeltaLocation = FVector::DotProduct(GetActorForwardVector(), Velocity) * DeltaTime;
-	float RotationAngle = DeltaLocation / MinTurningRadius * inSteering;
-	FQuat RotationDelta(GetActorUpVector(), RotationAngle);
-	Velocity = RotationDelta.RotateVector(Velocity);
+	FGoKartSimState State;
+	State.Location = GetActorLocation();
+	State.Rotation = GetActorQuat();
+	State.Velocity = Velocity;
+	return State;
+}
+
+void AGoKart::UpdateRotation(const FQuat& RotationDelta)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartRotationSweep);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, RotationSweep);
+
 	AddActorLocalRotation(RotationDelta, true);
 }
 
-void AGoKart::UpdateLocationFromVelocity(float DeltaTime)
+void AGoKart::UpdateLocation(const FVector& DeltaLocation)
 {
-	FVector DeltaLocation = Velocity * DeltaTime * 100.f;
-	FHitResult OutSweepHitResult;
-	AddActorWorldOffset(DeltaLocation, true, &OutSweepHitResult);
-	if (OutSweepHitResult.IsValidBlockingHit())
+	SCOPE_CYCLE_COUNTER(STAT_GoKartLocationSweep);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, LocationSweep);
+
+	if (SweepLocation(DeltaLocation))
 	{
 		Velocity = FVector::ZeroVector;
 	}
 }
 
+bool AGoKart::SweepLocation(const FVector& DeltaLocation)
+{
+	FVector Delta{ DeltaLocation };
+	bool bHitTrack = false;
+	if (TrackCollision)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_GoKartTrackSweep);
+		CSV_SCOPED_TIMING_STAT(KrazyKarts, TrackSweep);
+
+		float Time;
+		FVector Normal;
+		bHitTrack = TrackCollision->GetCollision().Sweep(GetActorLocation(), Delta, TrackCollisionExtent, Time, Normal);
+		if (bHitTrack)
+		{
+			Delta *= Time;
+		}
+	}
+
+	FHitResult OutSweepHitResult;
+	AddActorWorldOffset(Delta, true, &OutSweepHitResult);
+	return bHitTrack || OutSweepHitResult.IsValidBlockingHit();
+}
+
 // Called to bind functionality to input
 void AGoKart::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 {
@@ -180,15 +554,236 @@ void AGoKart::MoveRight(float Val)
 	Steering = Val;
 }
 
-bool AGoKart::Server_SendMove_Validate(const FGoKartMove& Move)
+void AGoKart::SendMoves()
+{
+	// Unreliable, so every send repeats the last few moves; a single lost packet is covered by the next one.
+	const int32 NumToSend = FMath::Min(FMath::Max(GetMoveRedundancy(), MovesSinceLastSend), UnackowledgedMoves.Num());
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+
+	// After a hitch more moves are new than one RPC may carry, so they go oldest first in several
+	if (NumToSend > MaxMovesPerSend)
+	{
+		UE_LOG(LogKrazyKarts, Warning, TEXT("%s: %d moves since the last send, split over %d RPCs"),
+			*GetName(), NumToSend, FMath::DivideAndRoundUp(NumToSend, MaxMovesPerSend));
+	}
+
+	for (int32 First = UnackowledgedMoves.Num() - NumToSend; First < UnackowledgedMoves.Num(); First += MaxMovesPerSend)
+	{
+		MovesToSend.Reset();
+		const int32 End = FMath::Min(First + MaxMovesPerSend, UnackowledgedMoves.Num());
+		for (int32 Index = First; Index < End; ++Index)
+		{
+			FGoKartPendingMove& PendingMove = UnackowledgedMoves[Index];
+			MovesToSend.Add(PendingMove.Move);
+			if (PendingMove.SentTime < 0.f)
+			{
+				PendingMove.SentTime = CurrentTime;
+			}
+		}
+		Server_SendMoves(MovesToSend);
+	}
+	MovesSinceLastSend = 0;
+}
+
+void AGoKart::UpdateSendRate(float DeltaTime)
+{
+	UNetConnection* Connection = GetNetConnection();
+	if (!bAdaptiveSendRate || !Connection)
+	{
+		return;
+	}
+
+	// AvgLag is the connection's round trip; the queue is saturated once the socket can't take this frame's data
+	SendRateController.Update(DeltaTime, Connection->AvgLag, !Connection->IsNetReady(false));
+	CSV_CUSTOM_STAT(KrazyKarts, MoveSendRate, SendRateController.GetSendRate(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(KrazyKarts, MoveRedundancy, GetMoveRedundancy(), ECsvCustomStatOp::Set);
+}
+
+float AGoKart::GetMoveSendRate() const
+{
+	return bAdaptiveSendRate && MoveSendRate > 0.f ? SendRateController.GetSendRate() : MoveSendRate;
+}
+
+int32 AGoKart::GetMoveRedundancy() const
+{
+	return bAdaptiveSendRate && MoveSendRate > 0.f ? SendRateController.GetRedundancy() : MoveRedundancy;
+}
+
+bool AGoKart::Server_SendMoves_Validate(const TArray<FGoKartMove>& Moves)
+{
+	return Moves.Num() <= MaxMovesPerSend;
+}
+
+void AGoKart::Server_SendMoves_Implementation(const TArray<FGoKartMove>& Moves)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartServerSendMoves);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, ServerSendMoves);
+
+	++NumMoveSendsReceived;
+	for (const FGoKartMove& Move : Moves)
+	{
+		// Redundant copies of moves we have already queued
+		if (Move.Sequence > LastReceivedMoveSequence)
+		{
+			LastReceivedMoveSequence = Move.Sequence;
+			if (LagCompensation)
+			{
+				// Before the move waits in the queue, so the clock offset is only the trip here
+				LagCompensation->RecordMoveReceived(this, Move.TimeStamp);
+			}
+			QueueServerMove(Move);
+		}
+	}
+}
+
+void AGoKart::QueueServerMove(FGoKartMove Move)
+{
+	if (!ValidateServerMove(Move))
+	{
+		++NumDroppedServerMoves;
+		INC_DWORD_STAT(STAT_GoKartServerMovesDropped);
+		return;
+	}
+
+	// A burst is simulated over the next frames rather than inside this RPC
+	if (!SimulationSubsystem)
+	{
+		ReceiveMove(Move);
+	}
+	else if (!ServerMoveQueue.Push(Move))
+	{
+		++NumDroppedServerMoves;
+		INC_DWORD_STAT(STAT_GoKartServerMovesDropped);
+	}
+	MaxServerMoveQueueDepth = FMath::Max(MaxServerMoveQueueDepth, ServerMoveQueue.Num());
+}
+
+bool AGoKart::ValidateServerMove(FGoKartMove& Move)
 {
-	return true;// FMath::Abs(Val) <= 1.0f;
+	// Both credits refill with server time, so over any stretch a client gets no more move time and
+	// no more moves than the time that really passed allows, plus what it may bank
+	const float MaxCredit = CVarMoveTimeCredit.GetValueOnGameThread();
+	const float MaxMoveRate = CVarMaxMoveRate.GetValueOnGameThread();
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	const float Elapsed = LastMoveCreditTime >= 0.f ? CurrentTime - LastMoveCreditTime : MaxCredit;
+	LastMoveCreditTime = CurrentTime;
+	MoveTimeCredit = FMath::Min(MoveTimeCredit + Elapsed * (1.f + MoveTimeCreditSlack), MaxCredit);
+	MoveCountCredit = FMath::Min(MoveCountCredit + Elapsed * MaxMoveRate, MaxCredit * MaxMoveRate);
+
+	if (MoveCountCredit < 1.f)
+	{
+		return false;
+	}
+	MoveCountCredit -= 1.f;
+
+	const float MaxDeltaTime = FMath::Max(FMath::Min(CVarMaxMoveDeltaTime.GetValueOnGameThread(), MoveTimeCredit), 0.f);
+	if (Move.DeltaTime > MaxDeltaTime)
+	{
+		Move.DeltaTime = MaxDeltaTime;
+		++NumClampedServerMoves;
+		INC_DWORD_STAT(STAT_GoKartServerMovesClamped);
+	}
+	MoveTimeCredit -= Move.DeltaTime;
+	return true;
 }
 
-void AGoKart::Server_SendMove_Implementation(const FGoKartMove& Move)
+int32 AGoKart::DrainServerMoves(int32 MaxMoves)
 {
+	const int32 NumToDrain = FMath::Min(MaxMoves, ServerMoveQueue.Num());
+	for (int32 Index = 0; Index < NumToDrain; ++Index)
+	{
+		ReceiveMove(ServerMoveQueue[Index]);
+	}
+	ServerMoveQueue.PopFront(NumToDrain);
+	return NumToDrain;
+}
+
+void AGoKart::TakePendingServerMoves(TArray<FGoKartMove>& OutMoves)
+{
+	OutMoves.Append(PendingServerMoves);
+	PendingServerMoves.Reset();
+}
+
+void AGoKart::ResetServerMoveStats()
+{
+	NumMoveSendsReceived = MaxServerMoveQueueDepth = NumDroppedServerMoves = NumClampedServerMoves = 0;
+}
+
+void AGoKart::ReceiveMove(const FGoKartMove& Move)
+{
+	INC_DWORD_STAT(STAT_GoKartServerMovesReceived);
+	CSV_CUSTOM_STAT(KrazyKarts, ServerMovesReceived, 1, ECsvCustomStatOp::Accumulate);
+
+	LastProcessedMoveSequence = Move.Sequence;
+	if (MoveRecorder)
+	{
+		MoveRecorder->RecordMove(GetUniqueID(), Move);
+	}
+
+	if (SimulationSubsystem && UGoKartSimulationSubsystem::IsBatchingEnabled())
+	{
+		PendingServerMoves.Add(Move);
+	}
+	else
+	{
+		ProcessMove(Move);
+	}
+}
+
+void AGoKart::ProcessMove(const FGoKartMove& Move)
+{
+	const uint64 StartCycles = ServerStats ? FPlatformTime::Cycles64() : 0;
 	SimulateMove(Move);
-	ServerState.LastMove	= Move;
+	if (ServerStats)
+	{
+		ServerStats->AddSimulateCost(FPlatformTime::Cycles64() - StartCycles);
+	}
+
+	UpdateServerState(Move);
+}
+
+void AGoKart::ApplyBatchedMoves(TArrayView<const FGoKartMove> Moves, const FQuat& Rotation, const FVector& DeltaLocation, const FVector& NewVelocity)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartApplyBatchedMoves);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, ApplyBatchedMoves);
+
+	// One sweep covers every move of the frame while the path is clear
+	const FGoKartSimState Start{ GetSimState() };
+	SetActorRotation(Rotation);
+	if (!SweepLocation(DeltaLocation))
+	{
+		Velocity = NewVelocity;
+	}
+	else
+	{
+		// The owning client sweeps after every move, stopping dead at the one that hits and driving on from there.
+		// Go back and do the same, or every contact with a wall would end in a correction.
+		INC_DWORD_STAT(STAT_GoKartBatchResweeps);
+		CSV_CUSTOM_STAT(KrazyKarts, BatchResweeps, 1, ECsvCustomStatOp::Accumulate);
+		SetActorLocationAndRotation(Start.Location, Start.Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+		Velocity = Start.Velocity;
+		for (const FGoKartMove& Move : Moves)
+		{
+			SimulateMove(Move);
+		}
+	}
+
+	UpdateServerState(Moves.Last());
+}
+
+void AGoKart::UpdateServerState(const FGoKartMove& LastMove)
+{
+	ServerState.LastMove	= LastMove;
 	ServerState.Transform	= GetActorTransform();
 	ServerState.Velocity	= Velocity;
-}
\ No newline at end of file
+
+	if (LagCompensation)
+	{
+		LagCompensation->Record(this, ServerState.Transform.GetLocation(), ServerState.Transform.GetRotation(), Velocity);
+	}
+
+	if (MoveRecorder)
+	{
+		MoveRecorder->RecordState(GetUniqueID(), LastMove, GetSimState(), SimConstants);
+	}
+}
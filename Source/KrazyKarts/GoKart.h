@@ -4,27 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Pawn.h"
+#include "GoKartSimulation.h"
+#include "GoKartRingBuffer.h"
+#include "GoKartSnapshotBuffer.h"
+#include "GoKartSendRate.h"
 #include "GoKart.generated.h"
 
 
-USTRUCT()
-struct FGoKartMove
-{
-	GENERATED_BODY()
-	
-	UPROPERTY()
-	float Throttle;
-
-	UPROPERTY()
-	float Steering;
-
-	UPROPERTY()
-	float DeltaTime;
-
-	UPROPERTY()
-	float TimeStamp;
-};
-
 USTRUCT()
 struct FGoKartMoveState
 {
@@ -38,6 +24,34 @@ struct FGoKartMoveState
 
 	UPROPERTY()
 	FTransform Transform;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FGoKartMoveState> : public TStructOpsTypeTraitsBase2<FGoKartMoveState>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+// A move the autonomous proxy has sent but the server has not acknowledged yet
+struct FGoKartPendingMove
+{
+	FGoKartMove Move;
+	FGoKartSimState PredictedState; // kart state right after Move was simulated
+	float SentTime{ -1.f }; // world time of the first send, negative until sent
+};
+
+UENUM()
+enum class EGoKartReconcileMode : uint8
+{
+	// Always snap to the server state and replay every pending move with its own sweeps
+	FullReplay,
+	// Skip corrections within the error thresholds, otherwise replay in local math and sweep once
+	Thresholded,
 };
 
 UCLASS()
@@ -53,7 +67,12 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Sizes the move and snapshot buffers; runs before the first OnRep_ServerState
+	virtual void PostInitializeComponents() override;
+
 public:	
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
@@ -61,6 +80,42 @@ public:
 	// Called to bind functionality to input
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
+	// Seconds other karts are drawn behind the newest server state they were received in
+	float GetSnapshotInterpolationDelay() const;
+
+	// Input axes, bound to the player's input or driven by UGoKartBotSubsystem
+	void MoveForward(float Val);
+	void MoveRight(float Val);
+
+	FGoKartSimState GetSimState() const;
+	const FGoKartSimConstants& GetSimConstants() const { return SimConstants; }
+
+	// Server: moves from the owning client waiting for UGoKartSimulationSubsystem's move budget
+	int32 GetNumQueuedServerMoves() const { return ServerMoveQueue.Num(); }
+	// Hands up to MaxMoves queued moves to ReceiveMove, returns how many
+	int32 DrainServerMoves(int32 MaxMoves);
+
+	// Server: drained moves waiting for UGoKartSimulationSubsystem's batched pass
+	int32 GetNumPendingServerMoves() const { return PendingServerMoves.Num(); }
+	// Appends the pending moves to OutMoves and clears them
+	void TakePendingServerMoves(TArray<FGoKartMove>& OutMoves);
+	// Applies a frame of moves integrated by UGoKartSimulationSubsystem, re-simulating them one sweep at a time if the path is blocked
+	void ApplyBatchedMoves(TArrayView<const FGoKartMove> Moves, const FQuat& Rotation, const FVector& DeltaLocation, const FVector& NewVelocity);
+
+	// Server: move traffic from the owning client since the last ResetServerMoveStats, for UKrazyKartsServerStats
+	int32 GetNumMoveSendsReceived() const { return NumMoveSendsReceived; }
+	int32 GetMaxServerMoveQueueDepth() const { return MaxServerMoveQueueDepth; }
+	int32 GetNumDroppedServerMoves() const { return NumDroppedServerMoves; }
+	int32 GetNumClampedServerMoves() const { return NumClampedServerMoves; }
+	void ResetServerMoveStats();
+
+	// For UGoKartDebugDrawSubsystem: the last acknowledged server transform, the states predicted since, and the last correction
+	const FTransform& GetServerTransform() const { return ServerState.Transform; }
+	int32 GetNumUnacknowledgedMoves() const { return UnackowledgedMoves.Num(); }
+	const FGoKartSimState& GetUnacknowledgedPredictedState(int32 Index) const { return UnackowledgedMoves[Index].PredictedState; }
+	float GetLastCorrectionDistance() const { return LastCorrectionDistance; }
+	float GetLastCorrectionTime() const { return LastCorrectionTime; }
+
 private:
 	UPROPERTY(EditAnywhere)
 	float Mass = 1000.f; // kg
@@ -72,30 +127,141 @@ private:
 	float DragCoefficient = 16.f; // kg/m
 	UPROPERTY(EditAnywhere)
 	float RollingResistanceCoefficient = 0.015f;
+	UPROPERTY(EditAnywhere)
+	float FixedSimulationRate = 0.f; // Hz the autonomous proxy creates moves at, e.g. 30, 60 or 120; 0 creates one per frame
+	UPROPERTY(EditAnywhere)
+	float MoveSendRate = 60.f; // Hz, 0 sends every frame; the highest rate when adapting
+	UPROPERTY(EditAnywhere)
+	int32 MoveRedundancy = 4; // most recent moves repeated in every send at MoveSendRate
+	UPROPERTY(EditAnywhere)
+	bool bAdaptiveSendRate = true; // lower the send rate and raise redundancy on slow or congested connections
+	UPROPERTY(EditAnywhere)
+	float MinMoveSendRate = 20.f; // Hz
+	UPROPERTY(EditAnywhere)
+	int32 MaxUnacknowledgedMoves = 256; // oldest moves are dropped once the server stops acking this many
+	UPROPERTY(EditAnywhere)
+	EGoKartReconcileMode ReconcileMode = EGoKartReconcileMode::Thresholded;
+	UPROPERTY(EditAnywhere)
+	float MaxLocationError = 2.f; // cm
+	UPROPERTY(EditAnywhere)
+	float MaxVelocityError = 0.05f; // m/s
+	UPROPERTY(EditAnywhere)
+	float MaxRotationError = 0.01f; // radians
+	UPROPERTY(EditAnywhere)
+	float SnapshotInterpolationDelay = 0.f; // s behind the newest server state, 0 uses 1.5 received update intervals
 
 	float Throttle{};
 	float Steering{};
 	FVector Velocity{};
 
-	TArray<FGoKartMove> UnackowledgedMoves;
+	TGoKartRingBuffer<FGoKartPendingMove> UnackowledgedMoves;
+	TArray<FGoKartMove> MovesToSend;
+	uint32 NextMoveSequence{ 1 };
+	int32 NumDroppedMoves{};
+	float TimeSinceMovesSent{};
+	int32 MovesSinceLastSend{};
+	uint32 LastProcessedMoveSequence{};
+	uint32 LastReceivedMoveSequence{}; // newest move from the owning client, queued or dropped
+
+	// Server: validated moves from the owning client, drained by UGoKartSimulationSubsystem within its move budget
+	TGoKartRingBuffer<FGoKartMove> ServerMoveQueue;
+	float MoveTimeCredit{}; // s of move time the client may still claim
+	float MoveCountCredit{}; // moves the client may still send
+	float LastMoveCreditTime{ -1.f };
+	int32 MaxServerMoveQueueDepth{}; // reset by ResetServerMoveStats, like the two below
+	int32 NumDroppedServerMoves{};
+	int32 NumClampedServerMoves{};
+	float DeltaTimeRemainder{}; // frame time lost to move quantization, carried into the next move
+	FGoKartSendRateController SendRateController;
+	int32 NumMoveSendsReceived{}; // server: Server_SendMoves calls, reset by ResetServerMoveStats
+
+	// Fixed rate simulation: frame time not yet simulated, and the last two simulated states to draw between
+	float SimAccumulator{};
+	FGoKartSimState PreviousSimState;
+	FGoKartSimState LastSimState;
+	bool bShowingRenderState{}; // actor is at the interpolated pose rather than LastSimState
+
+	FGoKartSnapshotBuffer Snapshots;
+
+	UPROPERTY(Transient)
+	class UKrazyKartsServerStats* ServerStats;
+
+	// Server moves waiting for UGoKartSimulationSubsystem when batching is enabled
+	UPROPERTY(Transient)
+	class UGoKartSimulationSubsystem* SimulationSubsystem;
+	TArray<FGoKartMove> PendingServerMoves;
+
+	UPROPERTY(Transient)
+	class UGoKartMoveRecorder* MoveRecorder;
+
+	UPROPERTY(Transient)
+	class UGoKartLagCompensationSubsystem* LagCompensation;
+
+	// Static level collision baked by GoKartTrackBake, null when the map has none
+	UPROPERTY(Transient)
+	class UGoKartTrackCollisionSubsystem* TrackCollision;
+	FVector TrackCollisionExtent{ FVector::ZeroVector };
+
+	// Reconciliation counters, logged once a second with kk.Net.LogReconciliation 1
+	int32 NumCorrections{};
+	int32 NumSkippedCorrections{};
+	int32 NumReplayedMoves{};
+	int32 NumServerStates{};
+	float SumPositionError{}; // cm between our prediction and each acknowledged server state
+	float MaxPositionError{};
+	int32 NumPositionErrors{};
+	int32 SumUnacknowledgedMoves{}; // pending moves after each acknowledgement
+	int32 MaxUnacknowledgedMovesSeen{};
+	uint64 ReconcileStatsStartInBytes{};
+	uint64 ReconcileStatsStartOutBytes{};
+	double ReconcileStatsStartTime{};
+
+	// Distance the kart jumped in its last correction
+	float LastCorrectionDistance{};
+	float LastCorrectionTime{ -BIG_NUMBER };
 
 	UPROPERTY(ReplicatedUsing=OnRep_ServerState)
 	FGoKartMoveState ServerState;
 	UFUNCTION()
 	void OnRep_ServerState();
 
-	FVector GetAirResistance();
-	FVector GetRollingResistance();
-	void UpdateLocationFromVelocity(float DeltaTime);
-	void UpdateRotation(const float DeltaTime, const float inSteering);
+	// Derived from the tuning values and world gravity, refreshed once per frame rather than per move
+	FGoKartSimConstants SimConstants;
 
-	void MoveForward(float Val);
-	void MoveRight(float Val);
+	FGoKartSimParams GetSimParams() const;
+
+	void UpdateLocation(const FVector& DeltaLocation);
+	// Moves by DeltaLocation, stopping at the baked track and then at anything PhysX finds. True if blocked.
+	bool SweepLocation(const FVector& DeltaLocation);
+	void UpdateRotation(const FQuat& RotationDelta);
+
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void Server_SendMoves(const TArray<FGoKartMove>& Moves);
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_SendMove(const FGoKartMove& Move);
+	void SendMoves();
+	void QueueServerMove(FGoKartMove Move);
+	bool ValidateServerMove(FGoKartMove& Move);
+	void UpdateSendRate(float DeltaTime);
+	float GetMoveSendRate() const;
+	int32 GetMoveRedundancy() const;
+	void ReceiveMove(const FGoKartMove& Move);
+	void ProcessMove(const FGoKartMove& Move);
+	void UpdateServerState(const FGoKartMove& LastMove);
 
 	void SimulateMove(const FGoKartMove& Move);
 	FGoKartMove CreateMove(float DeltaTime);
+	void PredictMove(float DeltaTime);
+	void TickFixedSimulation(float DeltaTime);
 	void ClearAknowledgeMoves(const FGoKartMove& inLastMove);
+
+	const FGoKartPendingMove* FindPendingMove(uint32 Sequence) const;
+	bool IsWithinErrorThreshold(const FGoKartSimState& Predicted) const;
+	void ReplayPendingMoves();
+	void ReportReconcileStats();
+
+	// Overrides player input with the kk.Test.ScriptedInput pattern
+	void ApplyScriptedInput();
+
+	void AddSnapshot();
+	void InterpolateSnapshots();
 };
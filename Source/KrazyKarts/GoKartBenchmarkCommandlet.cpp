@@ -0,0 +1,289 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartBenchmarkCommandlet.h"
+
+#include "KrazyKarts.h"
+#include "GoKartSimulation.h"
+#include "GoKartKernel.h"
+#include "GoKartMoveLog.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Math/RandomStream.h"
+#include "HAL/PlatformTime.h"
+
+namespace
+{
+	constexpr int32 NumInputs = 256;
+	constexpr float BenchmarkDeltaTime = 1.f / 60.f;
+
+	TArray<FGoKartMove> MakeInputs(FRandomStream& Random)
+	{
+		TArray<FGoKartMove> Inputs;
+		Inputs.SetNum(NumInputs);
+		for (int32 Index = 0; Index < NumInputs; ++Index)
+		{
+			Inputs[Index].Throttle = Random.FRandRange(-1.f, 1.f);
+			Inputs[Index].Steering = Random.FRandRange(-1.f, 1.f);
+			Inputs[Index].DeltaTime = BenchmarkDeltaTime;
+			Inputs[Index].TimeStamp = Index * BenchmarkDeltaTime;
+		}
+		return Inputs;
+	}
+
+	bool IsBitwiseEqual(const FVector& A, const FVector& B)
+	{
+		return FMemory::Memcmp(&A, &B, sizeof(FVector)) == 0;
+	}
+
+	bool IsBitwiseEqual(const FQuat& A, const FQuat& B)
+	{
+		return FMemory::Memcmp(&A, &B, sizeof(FQuat)) == 0;
+	}
+}
+
+UGoKartBenchmarkCommandlet::UGoKartBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UGoKartBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString KartCountsString{ TEXT("1,10,100,1000,10000") };
+	FParse::Value(*Params, TEXT("Karts="), KartCountsString, false);
+
+	int32 NumMoves = 2000000;
+	FParse::Value(*Params, TEXT("Moves="), NumMoves);
+
+	FString ReplayFilename;
+	if (FParse::Value(*Params, TEXT("Replay="), ReplayFilename))
+	{
+		return ReplayMoveLog(ReplayFilename) ? 0 : 1;
+	}
+
+	if (FParse::Param(*Params, TEXT("Verify")))
+	{
+		// Odd kart count so a partly filled SIMD register is covered too
+		const bool bScalarMatches = VerifyKernel(1023, 600, false);
+		const bool bSimdMatches = !GoKartKernel::IsSimdSupported() || VerifyKernel(1023, 600, true);
+		return bScalarMatches && bSimdMatches ? 0 : 1;
+	}
+
+	TArray<FString> KartCounts;
+	KartCountsString.ParseIntoArray(KartCounts, TEXT(","));
+	for (const FString& KartCount : KartCounts)
+	{
+		const int32 NumKarts = FCString::Atoi(*KartCount);
+		if (NumKarts > 0)
+		{
+			RunBenchmark(NumKarts, FMath::Max(NumMoves, NumKarts), false);
+			RunBenchmark(NumKarts, FMath::Max(NumMoves, NumKarts), true);
+		}
+	}
+	return 0;
+}
+
+void UGoKartBenchmarkCommandlet::RunBenchmark(int32 NumKarts, int32 NumMoves, bool bUseKernel) const
+{
+	// Inputs are generated up front so the timed loop only measures the integrator.
+	FRandomStream Random{ 1234 };
+	const TArray<FGoKartMove> Inputs{ MakeInputs(Random) };
+
+	const FGoKartSimConstants Constants{ FGoKartSimConstants::Make(FGoKartSimParams()) };
+	FGoKartKernelBatch Batch;
+	Batch.SetNum(NumKarts);
+	TArray<FGoKartSimState> States;
+	States.SetNum(NumKarts);
+	for (int32 Kart = 0; Kart < NumKarts; ++Kart)
+	{
+		States[Kart].Location = FVector(Kart * 500.f, 0.f, 0.f);
+	}
+
+	const int32 NumSteps = FMath::Max(1, NumMoves / NumKarts);
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Step = 0; Step < NumSteps; ++Step)
+	{
+		if (bUseKernel)
+		{
+			for (int32 Kart = 0; Kart < NumKarts; ++Kart)
+			{
+				Batch.SetLane(Kart, Constants, States[Kart].Rotation, States[Kart].Velocity, Inputs[(Step + Kart) % NumInputs]);
+			}
+			GoKartKernel::Integrate(Batch);
+			for (int32 Kart = 0; Kart < NumKarts; ++Kart)
+			{
+				States[Kart].Velocity = Batch.GetVelocity(Kart);
+				States[Kart].Rotation = States[Kart].Rotation * Batch.GetRotationDelta(Kart);
+				States[Kart].Location = States[Kart].Location + Batch.GetLocationDelta(Kart);
+			}
+		}
+		else
+		{
+			for (int32 Kart = 0; Kart < NumKarts; ++Kart)
+			{
+				States[Kart] = GoKartSimulation::Step(States[Kart], Inputs[(Step + Kart) % NumInputs], Constants);
+			}
+		}
+	}
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+
+	// The checksum keeps the loop from being optimised away and flags any change in results.
+	FVector Checksum{ FVector::ZeroVector };
+	for (const FGoKartSimState& State : States)
+	{
+		Checksum += State.Location;
+	}
+
+	const double TotalMoves = double(NumSteps) * NumKarts;
+	UE_LOG(LogKrazyKarts, Display, TEXT("GoKartBenchmark: %-6s %6d karts %12.0f moves/s %8.2f ns/move checksum %s"),
+		bUseKernel ? (GoKartKernel::IsSimdSupported() ? TEXT("simd") : TEXT("kernel")) : TEXT("scalar"),
+		NumKarts, TotalMoves / Elapsed, Elapsed * 1.0e9 / TotalMoves, *Checksum.ToString());
+}
+
+bool UGoKartBenchmarkCommandlet::VerifyKernel(int32 NumKarts, int32 NumSteps, bool bAllowSimd) const
+{
+	// Varied tuning, orientations and speeds, including karts standing still and at exactly unit speed
+	FRandomStream Random{ 4321 };
+	const TArray<FGoKartMove> Inputs{ MakeInputs(Random) };
+
+	TArray<FGoKartSimParams> KartParams;
+	TArray<FGoKartSimConstants> Constants;
+	TArray<FGoKartSimState> Expected;
+	TArray<FGoKartSimState> Actual;
+	for (int32 Kart = 0; Kart < NumKarts; ++Kart)
+	{
+		FGoKartSimParams Params;
+		Params.Mass = Random.FRandRange(200.f, 2000.f);
+		Params.MaxDrivingForce = Random.FRandRange(1000.f, 20000.f);
+		Params.MinTurningRadius = Random.FRandRange(2.f, 30.f);
+		Params.DragCoefficient = Random.FRandRange(1.f, 30.f);
+		Params.RollingResistanceCoefficient = Random.FRandRange(0.f, 0.05f);
+		Params.GravityZ = Random.FRandRange(-1200.f, -800.f);
+		KartParams.Add(Params);
+		Constants.Add(FGoKartSimConstants::Make(Params));
+
+		FGoKartSimState State;
+		State.Location = Random.GetUnitVector() * Random.FRandRange(0.f, 100000.f);
+		State.Rotation = FRotator(Random.FRandRange(-30.f, 30.f), Random.FRandRange(-180.f, 180.f), Random.FRandRange(-30.f, 30.f)).Quaternion();
+		State.Velocity = Kart % 8 == 0 ? FVector::ZeroVector : Kart % 8 == 1 ? FVector::ForwardVector : Random.GetUnitVector() * Random.FRandRange(0.f, 40.f);
+		Expected.Add(State);
+		Actual.Add(State);
+	}
+
+	FGoKartKernelBatch Batch;
+	Batch.SetNum(NumKarts);
+	int32 NumMismatches = 0;
+	for (int32 Step = 0; Step < NumSteps; ++Step)
+	{
+		for (int32 Kart = 0; Kart < NumKarts; ++Kart)
+		{
+			const FGoKartMove& Move = Inputs[(Step * 7 + Kart) % NumInputs];
+			// The reference model, straight from the tuning values
+			Expected[Kart] = GoKartSimulation::Step(Expected[Kart], Move, KartParams[Kart]);
+			Batch.SetLane(Kart, Constants[Kart], Actual[Kart].Rotation, Actual[Kart].Velocity, Move);
+		}
+
+		GoKartKernel::Integrate(Batch, bAllowSimd);
+
+		for (int32 Kart = 0; Kart < NumKarts; ++Kart)
+		{
+			FGoKartSimState& State = Actual[Kart];
+			State.Velocity = Batch.GetVelocity(Kart);
+			State.Rotation = State.Rotation * Batch.GetRotationDelta(Kart);
+			State.Location = State.Location + Batch.GetLocationDelta(Kart);
+
+			if (!IsBitwiseEqual(State.Velocity, Expected[Kart].Velocity) || !IsBitwiseEqual(State.Rotation, Expected[Kart].Rotation) || !IsBitwiseEqual(State.Location, Expected[Kart].Location))
+			{
+				UE_CLOG(NumMismatches == 0, LogKrazyKarts, Error, TEXT("GoKartBenchmark: kart %d step %d differs, expected %s %s, got %s %s"),
+					Kart, Step, *Expected[Kart].Location.ToString(), *Expected[Kart].Velocity.ToString(), *State.Location.ToString(), *State.Velocity.ToString());
+				++NumMismatches;
+
+				// Resynchronise so one difference is not reported again on every later step
+				State = Expected[Kart];
+			}
+		}
+	}
+
+	UE_LOG(LogKrazyKarts, Display, TEXT("GoKartBenchmark: %s kernel %s, %d mismatches in %d moves"),
+		bAllowSimd ? TEXT("simd") : TEXT("scalar"), NumMismatches == 0 ? TEXT("matches Step") : TEXT("DIFFERS from Step"), NumMismatches, NumKarts * NumSteps);
+	return NumMismatches == 0;
+}
+
+bool UGoKartBenchmarkCommandlet::ReplayMoveLog(const FString& Filename) const
+{
+	TUniquePtr<IMappedFileHandle> MappedFile{ FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename) };
+	TUniquePtr<IMappedFileRegion> Region{ MappedFile ? MappedFile->MapRegion() : nullptr };
+	if (!Region || Region->GetMappedSize() > MAX_int32)
+	{
+		UE_LOG(LogKrazyKarts, Error, TEXT("GoKartBenchmark: could not map move log %s"), *Filename);
+		return false;
+	}
+
+	FGoKartMoveLogReader Reader;
+	if (!Reader.Open(MakeArrayView(Region->GetMappedPtr(), int32(Region->GetMappedSize()))))
+	{
+		UE_LOG(LogKrazyKarts, Error, TEXT("GoKartBenchmark: %s is not a move log"), *Filename);
+		return false;
+	}
+
+	struct FReplayKart
+	{
+		FGoKartSimState State;
+		FGoKartSimConstants Constants;
+		uint32 LastSequence{};
+	};
+	TMap<uint32, FReplayKart> Karts;
+
+	int64 NumMoves = 0;
+	int64 NumSkippedMoves = 0;
+	int64 NumKeyframes = 0;
+	int64 NumCompared = 0;
+	double SumDrift = 0.0;
+	float MaxDrift = 0.f;
+
+	// Karts start at their first keyframe; later keyframes measure drift and then resynchronise,
+	// since the replay has no level to collide with
+	const double StartTime = FPlatformTime::Seconds();
+	FGoKartMoveLogRecord Record;
+	while (Reader.Next(Record))
+	{
+		FReplayKart* Kart = Karts.Find(Record.KartId);
+		if (Record.Type == EGoKartMoveLogRecordType::Move)
+		{
+			if (Kart && Record.Move.Sequence == Kart->LastSequence + 1)
+			{
+				Kart->State = GoKartSimulation::Step(Kart->State, Record.Move, Kart->Constants);
+				Kart->LastSequence = Record.Move.Sequence;
+				++NumMoves;
+			}
+			else
+			{
+				++NumSkippedMoves;
+			}
+			continue;
+		}
+
+		++NumKeyframes;
+		if (Kart && Kart->LastSequence == Record.Move.Sequence)
+		{
+			const float Drift = FVector::Dist(Kart->State.Location, Record.State.Location);
+			SumDrift += Drift;
+			MaxDrift = FMath::Max(MaxDrift, Drift);
+			++NumCompared;
+		}
+
+		FReplayKart& Resync = Kart ? *Kart : Karts.Add(Record.KartId);
+		Resync.State = Record.State;
+		Resync.Constants = Record.Constants;
+		Resync.LastSequence = Record.Move.Sequence;
+	}
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogKrazyKarts, Display, TEXT("GoKartBenchmark: replayed %s: %d karts, %lld moves (%lld skipped), %lld keyframes, %.0f moves/s"),
+		*Filename, Karts.Num(), NumMoves, NumSkippedMoves, NumKeyframes, Elapsed > 0.0 ? NumMoves / Elapsed : 0.0);
+	UE_LOG(LogKrazyKarts, Display, TEXT("GoKartBenchmark: drift from server at %lld keyframes: mean %.3f cm, max %.3f cm"),
+		NumCompared, NumCompared > 0 ? SumDrift / NumCompared : 0.0, MaxDrift);
+	UE_CLOG(Reader.IsCorrupt(), LogKrazyKarts, Warning, TEXT("GoKartBenchmark: %s ends in a truncated or corrupt record"), *Filename);
+	return !Reader.IsCorrupt();
+}
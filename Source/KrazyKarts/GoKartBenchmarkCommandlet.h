@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GoKartBenchmarkCommandlet.generated.h"
+
+/**
+ * Headless throughput benchmark for the kart integrator. Runs GoKartSimulation::Step and the
+ * GoKartKernel batch over deterministic input for a range of kart counts and logs moves/sec
+ * and ns/move. -Verify instead checks that the kernel matches the reference Step, computed
+ * from the tuning values, bit for bit and returns non-zero when it does not. -Replay
+ * memory-maps a log recorded with kk.Net.RecordMoves and steps every move in it as fast as
+ * possible, reporting how far the collision-free replay drifts from the server at each
+ * keyframe.
+ *
+ * UE4Editor-Cmd KrazyKarts.uproject -run=GoKartBenchmark [-Karts=1,10,100,1000,10000] [-Moves=2000000] [-Verify] [-Replay=<file>]
+ */
+UCLASS()
+class UGoKartBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGoKartBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	void RunBenchmark(int32 NumKarts, int32 NumMoves, bool bUseKernel) const;
+	bool VerifyKernel(int32 NumKarts, int32 NumSteps, bool bAllowSimd) const;
+	bool ReplayMoveLog(const FString& Filename) const;
+};
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartBotController.h"
+
+#include "GoKartBotSubsystem.h"
+#include "Engine/World.h"
+
+void AGoKartBotController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	if (UGoKartBotSubsystem* Bots = GetWorld()->GetSubsystem<UGoKartBotSubsystem>())
+	{
+		Bots->Register(InPawn);
+	}
+}
+
+void AGoKartBotController::OnUnPossess()
+{
+	if (UGoKartBotSubsystem* Bots = GetWorld()->GetSubsystem<UGoKartBotSubsystem>())
+	{
+		Bots->Unregister(GetPawn());
+	}
+
+	Super::OnUnPossess();
+}
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "GoKartBotController.generated.h"
+
+/**
+ * Server side bot. Hands its pawn to UGoKartBotSubsystem, which drives it around the track
+ * spline through the pawn's own MoveForward and MoveRight, so its moves are created and
+ * simulated like those of a kart controlled on the server.
+ */
+UCLASS()
+class KRAZYKARTS_API AGoKartBotController : public AAIController
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void OnPossess(APawn* InPawn) override;
+	virtual void OnUnPossess() override;
+};
@@ -0,0 +1,296 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartBotSubsystem.h"
+
+#include "KrazyKarts.h"
+#include "GoKart.h"
+#include "GoKartBotController.h"
+#include "GoKartTrackSpline.h"
+#include "KrazyKartsPawn.h"
+#include "Async/ParallelFor.h"
+#include "Components/SplineComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarBotInput(
+		TEXT("kk.Test.BotInput"),
+		0,
+		TEXT("Drive the local players' karts around the track spline instead of player input, for headless fake clients."));
+
+	FAutoConsoleCommandWithWorldAndArgs SpawnBotsCommand(
+		TEXT("kk.Test.SpawnBots"),
+		TEXT("Server: spawn bot karts that drive around the track spline. Argument: number of bots (default 1)."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+		{
+			UGoKartBotSubsystem* Bots = World ? World->GetSubsystem<UGoKartBotSubsystem>() : nullptr;
+			if (Bots)
+			{
+				Bots->SpawnBots(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1);
+			}
+		}));
+
+	constexpr int32 BotsPerChunk = 64;
+
+	// Samples searched behind and ahead of last frame's nearest one
+	constexpr int32 SearchBehind = 4;
+	constexpr int32 SearchAhead = 32;
+
+	// cm a bot may be from the nearest sample in its window before the whole track is searched, e.g. after a respawn
+	constexpr float MaxTrackedDistance = 2000.f;
+
+	// A bot slower than StuckSpeed cm/s for StuckTime s reverses with opposite lock for ReverseTime s
+	constexpr float StuckSpeed = 50.f;
+	constexpr float StuckTime = 2.f;
+	constexpr float ReverseTime = 1.f;
+
+	// cm between spawned bots across the track
+	constexpr float SpawnLateralOffset = 150.f;
+}
+
+DECLARE_CYCLE_STAT(TEXT("Bot Drivers"), STAT_GoKartBots, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Bots"), STAT_GoKartNumBots, STATGROUP_KrazyKarts);
+
+bool UGoKartBotSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UGoKartBotSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	SampleTrack();
+}
+
+void UGoKartBotSubsystem::SampleTrack()
+{
+	SampleLocations.Reset();
+	SampleDirections.Reset();
+
+	TActorIterator<AGoKartTrackSpline> It(GetWorld());
+	if (!It)
+	{
+		UE_LOG(LogKrazyKarts, Log, TEXT("No AGoKartTrackSpline in %s, bots cannot drive"), *GetWorld()->GetMapName());
+		return;
+	}
+
+	const USplineComponent* Spline = It->GetSpline();
+	const float Length = Spline->GetSplineLength();
+	const int32 NumSamples = FMath::Max(FMath::CeilToInt(Length / FMath::Max(SampleSpacing, 1.f)), 2);
+	SampleLocations.Reserve(NumSamples);
+	SampleDirections.Reserve(NumSamples);
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		const float Distance = Length * Index / NumSamples;
+		SampleLocations.Add(Spline->GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World));
+		SampleDirections.Add(Spline->GetDirectionAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World));
+	}
+}
+
+bool UGoKartBotSubsystem::IsTickable() const
+{
+	return !IsTemplate() && SampleLocations.Num() > 0 && (Bots.Num() > 0 || CVarBotInput.GetValueOnGameThread() != 0);
+}
+
+TStatId UGoKartBotSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGoKartBotSubsystem, STATGROUP_Tickables);
+}
+
+void UGoKartBotSubsystem::Register(APawn* Pawn)
+{
+	if (Pawn && !Bots.ContainsByPredicate([Pawn](const FBot& Bot) { return Bot.Pawn == Pawn; }))
+	{
+		FBot& Bot = Bots.AddDefaulted_GetRef();
+		Bot.Pawn = Pawn;
+		Bot.LastLocation = Pawn->GetActorLocation();
+	}
+}
+
+void UGoKartBotSubsystem::Unregister(APawn* Pawn)
+{
+	Bots.RemoveAllSwap([Pawn](const FBot& Bot) { return Bot.Pawn == Pawn; });
+}
+
+void UGoKartBotSubsystem::UpdateLocalPlayers()
+{
+	const bool bEnabled = CVarBotInput.GetValueOnGameThread() != 0;
+	for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		APlayerController* PlayerController = Iterator->Get();
+		APawn* Pawn = PlayerController && PlayerController->IsLocalController() ? PlayerController->GetPawn() : nullptr;
+		if (!Pawn)
+		{
+			continue;
+		}
+
+		FBot* Bot = Bots.FindByPredicate([Pawn](const FBot& Entry) { return Entry.Pawn == Pawn; });
+		if (bEnabled && !Bot)
+		{
+			// Otherwise the input bindings zero the throttle and steering before the pawn ticks
+			Pawn->DisableInput(PlayerController);
+			Register(Pawn);
+			Bots.Last().bLocalPlayer = true;
+		}
+		else if (!bEnabled && Bot && Bot->bLocalPlayer)
+		{
+			Pawn->EnableInput(PlayerController);
+			Unregister(Pawn);
+		}
+	}
+}
+
+void UGoKartBotSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartBots);
+
+	UpdateLocalPlayers();
+	Bots.RemoveAllSwap([](const FBot& Bot) { return !Bot.Pawn.IsValid(); });
+	SET_DWORD_STAT(STAT_GoKartNumBots, Bots.Num());
+
+	BotLocations.Reset(Bots.Num());
+	BotRotations.Reset(Bots.Num());
+	for (const FBot& Bot : Bots)
+	{
+		BotLocations.Add(Bot.Pawn->GetActorLocation());
+		BotRotations.Add(Bot.Pawn->GetActorQuat());
+	}
+	BotThrottles.SetNumUninitialized(Bots.Num());
+	BotSteerings.SetNumUninitialized(Bots.Num());
+
+	// Reads only the copied transforms and the track samples, and writes only its own bots
+	const int32 NumChunks = FMath::DivideAndRoundUp(Bots.Num(), BotsPerChunk);
+	ParallelFor(NumChunks, [this, DeltaTime](int32 Chunk)
+	{
+		const int32 End = FMath::Min((Chunk + 1) * BotsPerChunk, Bots.Num());
+		for (int32 Index = Chunk * BotsPerChunk; Index < End; ++Index)
+		{
+			DriveBot(Bots[Index], BotLocations[Index], BotRotations[Index], DeltaTime, BotThrottles[Index], BotSteerings[Index]);
+		}
+	}, NumChunks < 2);
+
+	// Used by the pawns' next moves
+	for (int32 Index = 0; Index < Bots.Num(); ++Index)
+	{
+		ApplyInput(*Bots[Index].Pawn, BotThrottles[Index], BotSteerings[Index]);
+	}
+}
+
+void UGoKartBotSubsystem::DriveBot(FBot& Bot, const FVector& Location, const FQuat& Rotation, float DeltaTime, float& OutThrottle, float& OutSteering) const
+{
+	const float Speed = DeltaTime > 0.f ? FVector::Dist(Location, Bot.LastLocation) / DeltaTime : 0.f;
+	Bot.LastLocation = Location;
+	Bot.Sample = FindNearestSample(Location, Bot.Sample);
+
+	const int32 NumSamples = SampleLocations.Num();
+	const int32 LookAhead = FMath::Max(FMath::CeilToInt(FMath::Max(Speed * LookAheadTime, MinLookAhead) / FMath::Max(SampleSpacing, 1.f)), 1);
+	const FVector ToTarget{ Rotation.UnrotateVector(SampleLocations[(Bot.Sample + LookAhead) % NumSamples] - Location) };
+	const float Angle = FMath::RadiansToDegrees(FMath::Atan2(ToTarget.Y, ToTarget.X));
+	OutSteering = FMath::Clamp(Angle / MaxSteeringAngle, -1.f, 1.f);
+
+	const FVector& FarDirection = SampleDirections[(Bot.Sample + 2 * LookAhead) % NumSamples];
+	const bool bCornerAhead = FVector::DotProduct(SampleDirections[Bot.Sample], FarDirection) < FMath::Cos(FMath::DegreesToRadians(CornerAngle));
+	OutThrottle = bCornerAhead ? CornerThrottle : 1.f;
+
+	if (Bot.ReverseTime > 0.f)
+	{
+		Bot.ReverseTime -= DeltaTime;
+		OutThrottle = -1.f;
+		OutSteering = -OutSteering;
+	}
+	else if (Speed < StuckSpeed)
+	{
+		Bot.StuckTime += DeltaTime;
+		if (Bot.StuckTime > StuckTime)
+		{
+			Bot.StuckTime = 0.f;
+			Bot.ReverseTime = ReverseTime;
+		}
+	}
+	else
+	{
+		Bot.StuckTime = 0.f;
+	}
+}
+
+int32 UGoKartBotSubsystem::FindNearestSample(const FVector& Location, int32 Hint) const
+{
+	const int32 NumSamples = SampleLocations.Num();
+	int32 Best = INDEX_NONE;
+	float BestDistanceSquared = MAX_flt;
+	if (Hint != INDEX_NONE)
+	{
+		for (int32 Offset = -SearchBehind; Offset <= SearchAhead; ++Offset)
+		{
+			const int32 Index = (Hint + Offset + NumSamples) % NumSamples;
+			const float DistanceSquared = FVector::DistSquared(SampleLocations[Index], Location);
+			if (DistanceSquared < BestDistanceSquared)
+			{
+				Best = Index;
+				BestDistanceSquared = DistanceSquared;
+			}
+		}
+		if (BestDistanceSquared <= FMath::Square(MaxTrackedDistance))
+		{
+			return Best;
+		}
+	}
+
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		const float DistanceSquared = FVector::DistSquared(SampleLocations[Index], Location);
+		if (DistanceSquared < BestDistanceSquared)
+		{
+			Best = Index;
+			BestDistanceSquared = DistanceSquared;
+		}
+	}
+	return Best;
+}
+
+void UGoKartBotSubsystem::ApplyInput(APawn& Pawn, float Throttle, float Steering)
+{
+	if (AGoKart* Kart = Cast<AGoKart>(&Pawn))
+	{
+		Kart->MoveForward(Throttle);
+		Kart->MoveRight(Steering);
+	}
+	else if (AKrazyKartsPawn* Vehicle = Cast<AKrazyKartsPawn>(&Pawn))
+	{
+		Vehicle->MoveForward(Throttle);
+		Vehicle->MoveRight(Steering);
+	}
+}
+
+void UGoKartBotSubsystem::SpawnBots(int32 Count)
+{
+	UWorld* World = GetWorld();
+	const AGameModeBase* GameMode = World->GetAuthGameMode();
+	if (!GameMode || !GameMode->DefaultPawnClass || SampleLocations.Num() == 0 || Count <= 0)
+	{
+		UE_LOG(LogKrazyKarts, Warning, TEXT("SpawnBots needs a server with a default pawn class and an AGoKartTrackSpline"));
+		return;
+	}
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		// Evenly around the lap, alternating sides of the racing line
+		const int32 Sample = int32(int64(Index) * SampleLocations.Num() / Count);
+		const FQuat Rotation{ SampleDirections[Sample].ToOrientationQuat() };
+		const FVector Offset{ Rotation.GetRightVector() * (Index % 2 ? SpawnLateralOffset : -SpawnLateralOffset) };
+		APawn* Pawn = World->SpawnActor<APawn>(GameMode->DefaultPawnClass, SampleLocations[Sample] + Offset, Rotation.Rotator(), SpawnParameters);
+		AGoKartBotController* Controller = Pawn ? World->SpawnActor<AGoKartBotController>() : nullptr;
+		if (Controller)
+		{
+			Controller->Possess(Pawn);
+		}
+	}
+	UE_LOG(LogKrazyKarts, Display, TEXT("Spawned %d bots, %d driving"), Count, Bots.Num());
+}
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "GoKartBotSubsystem.generated.h"
+
+/**
+ * Drives bot karts around the track for load tests. The first AGoKartTrackSpline in the map is
+ * sampled once at SampleSpacing when play begins; every frame all bots are then steered in one
+ * pass, each searching the samples around the one it was nearest last frame, split across
+ * workers with ParallelFor once there are enough bots. The result goes through the pawn's
+ * MoveForward and MoveRight, so AGoKart and AKrazyKartsPawn create, send and simulate moves
+ * exactly as they do for a player.
+ *
+ * Bots are pawns possessed by AGoKartBotController on the server, spawned with
+ * kk.Test.SpawnBots, or the player pawns of a client running kk.Test.BotInput 1, which makes
+ * headless fake clients out of clients started with -nullrhi.
+ */
+UCLASS(config=Game)
+class UGoKartBotSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	void Register(APawn* Pawn);
+	void Unregister(APawn* Pawn);
+
+	// Server: spawns Count of the game mode's default pawn spread around the track, each possessed by a bot
+	void SpawnBots(int32 Count);
+
+	/** cm between cached track samples */
+	UPROPERTY(config)
+	float SampleSpacing = 200.f;
+
+	/** Bots steer at the track this far ahead, in seconds at their current speed but at least MinLookAhead cm */
+	UPROPERTY(config)
+	float LookAheadTime = 0.5f;
+	UPROPERTY(config)
+	float MinLookAhead = 600.f;
+
+	/** Degrees off the kart's heading that take full steering lock */
+	UPROPERTY(config)
+	float MaxSteeringAngle = 30.f;
+
+	/** Throttle while the track twice the look ahead away turns more than CornerAngle degrees from here */
+	UPROPERTY(config)
+	float CornerThrottle = 0.5f;
+	UPROPERTY(config)
+	float CornerAngle = 45.f;
+
+private:
+	struct FBot
+	{
+		TWeakObjectPtr<APawn> Pawn;
+		int32 Sample{ INDEX_NONE }; // nearest track sample last frame
+		FVector LastLocation{ FVector::ZeroVector };
+		float StuckTime{};
+		float ReverseTime{};
+		bool bLocalPlayer{};
+	};
+
+	void SampleTrack();
+	void UpdateLocalPlayers();
+	void DriveBot(FBot& Bot, const FVector& Location, const FQuat& Rotation, float DeltaTime, float& OutThrottle, float& OutSteering) const;
+	int32 FindNearestSample(const FVector& Location, int32 Hint) const;
+	static void ApplyInput(APawn& Pawn, float Throttle, float Steering);
+
+	// Track samples in driving order, wrapping around
+	TArray<FVector> SampleLocations;
+	TArray<FVector> SampleDirections;
+
+	TArray<FBot> Bots;
+
+	// Reused every frame
+	TArray<FVector> BotLocations;
+	TArray<FQuat> BotRotations;
+	TArray<float> BotThrottles;
+	TArray<float> BotSteerings;
+};
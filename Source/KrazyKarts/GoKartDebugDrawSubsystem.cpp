@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartDebugDrawSubsystem.h"
+
+#include "KrazyKarts.h"
+#include "GoKart.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarDebugNet(
+		TEXT("kk.Debug.Net"),
+		0,
+		TEXT("Draw kart netcode state: server ghost, unacknowledged move trail and correction size."));
+
+	// Roughly the kart body, in cm
+	const FVector GhostExtent{ 100.f, 60.f, 30.f };
+
+	// Correction bar: cm of bar per cm of correction, capped, fading out over a second
+	constexpr float CorrectionBarScale = 10.f;
+	constexpr float MaxCorrectionBarLength = 300.f;
+	constexpr float CorrectionFadeTime = 1.f;
+
+	FLinearColor GetRoleColor(ENetRole Role)
+	{
+		switch (Role)
+		{
+		case ROLE_AutonomousProxy:
+			return FLinearColor::Green;
+		case ROLE_SimulatedProxy:
+			return FLinearColor(0.2f, 0.4f, 1.f);
+		default:
+			return FLinearColor::White;
+		}
+	}
+}
+
+DECLARE_CYCLE_STAT(TEXT("Net Debug Draw"), STAT_GoKartDebugDraw, STATGROUP_KrazyKarts);
+
+bool UGoKartDebugDrawSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+#if WITH_GOKART_DEBUG_DRAW
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && World->GetNetMode() != NM_DedicatedServer;
+#else
+	return false;
+#endif // WITH_GOKART_DEBUG_DRAW
+}
+
+bool UGoKartDebugDrawSubsystem::IsTickable() const
+{
+	return !IsTemplate() && CVarDebugNet.GetValueOnGameThread() != 0;
+}
+
+TStatId UGoKartDebugDrawSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGoKartDebugDrawSubsystem, STATGROUP_Tickables);
+}
+
+void UGoKartDebugDrawSubsystem::Tick(float DeltaTime)
+{
+#if WITH_GOKART_DEBUG_DRAW
+	SCOPE_CYCLE_COUNTER(STAT_GoKartDebugDraw);
+
+	ULineBatchComponent* LineBatcher = GetWorld()->LineBatcher;
+	if (!LineBatcher)
+	{
+		return;
+	}
+
+	Lines.Reset();
+	for (TActorIterator<AGoKart> It(GetWorld()); It; ++It)
+	{
+		AddKart(**It);
+	}
+	LineBatcher->DrawLines(Lines);
+#endif // WITH_GOKART_DEBUG_DRAW
+}
+
+void UGoKartDebugDrawSubsystem::AddKart(const AGoKart& Kart)
+{
+#if WITH_GOKART_DEBUG_DRAW
+	const FTransform DisplayTransform{ Kart.GetActorTransform() };
+	AddBox(DisplayTransform, GetRoleColor(Kart.GetLocalRole()));
+
+	// The server's kart is the displayed one, so only clients have a ghost
+	if (Kart.GetLocalRole() != ROLE_Authority)
+	{
+		AddBox(Kart.GetServerTransform(), FLinearColor::Red);
+		Lines.Emplace(DisplayTransform.GetLocation(), Kart.GetServerTransform().GetLocation(), FLinearColor::Red, 0.f, 0.f, SDPG_World);
+	}
+
+	// Predicted path still waiting for the server, from the acknowledged state onwards
+	FVector Previous{ Kart.GetServerTransform().GetLocation() };
+	for (int32 Index = 0; Index < Kart.GetNumUnacknowledgedMoves(); ++Index)
+	{
+		const FVector& Location = Kart.GetUnacknowledgedPredictedState(Index).Location;
+		Lines.Emplace(Previous, Location, FLinearColor::Yellow, 0.f, 0.f, SDPG_World);
+		Previous = Location;
+	}
+
+	const float TimeSinceCorrection = GetWorld()->GetTimeSeconds() - Kart.GetLastCorrectionTime();
+	if (TimeSinceCorrection < CorrectionFadeTime)
+	{
+		const float Length = FMath::Min(Kart.GetLastCorrectionDistance() * CorrectionBarScale, MaxCorrectionBarLength);
+		const FVector Base{ DisplayTransform.GetLocation() + FVector(0.f, 0.f, GhostExtent.Z * 2.f) };
+		const FLinearColor Color{ FLinearColor::LerpUsingHSV(FLinearColor::Green, FLinearColor::Red, Length / MaxCorrectionBarLength) };
+		Lines.Emplace(Base, Base + FVector(0.f, 0.f, Length), Color * (1.f - TimeSinceCorrection / CorrectionFadeTime), 0.f, 8.f, SDPG_World);
+	}
+#endif // WITH_GOKART_DEBUG_DRAW
+}
+
+void UGoKartDebugDrawSubsystem::AddBox(const FTransform& Transform, const FLinearColor& Color)
+{
+#if WITH_GOKART_DEBUG_DRAW
+	FVector Corners[8];
+	for (int32 Index = 0; Index < 8; ++Index)
+	{
+		const FVector Local{ Index & 1 ? GhostExtent.X : -GhostExtent.X, Index & 2 ? GhostExtent.Y : -GhostExtent.Y, Index & 4 ? GhostExtent.Z : -GhostExtent.Z };
+		Corners[Index] = Transform.TransformPosition(Local);
+	}
+
+	// Each edge joins two corners that differ in exactly one axis bit
+	for (int32 Index = 0; Index < 8; ++Index)
+	{
+		for (int32 Axis = 1; Axis < 8; Axis <<= 1)
+		{
+			if ((Index & Axis) == 0)
+			{
+				Lines.Emplace(Corners[Index], Corners[Index | Axis], Color, 0.f, 0.f, SDPG_World);
+			}
+		}
+	}
+#endif // WITH_GOKART_DEBUG_DRAW
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Components/LineBatchComponent.h"
+#include "GoKartDebugDrawSubsystem.generated.h"
+
+class AGoKart;
+
+/**
+ * Netcode overlay for every kart, toggled with kk.Debug.Net 1. Draws the last server
+ * transform as a ghost box next to the displayed kart, the trail of moves still waiting for
+ * acknowledgement and a bar for the size of the last correction. Lines for all karts go to
+ * the world line batcher in one call per frame. Not created in Shipping or on dedicated
+ * servers, and doesn't tick while the cvar is 0.
+ */
+UCLASS()
+class UGoKartDebugDrawSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+private:
+	void AddKart(const AGoKart& Kart);
+	void AddBox(const FTransform& Transform, const FLinearColor& Color);
+
+	// Reused every frame
+	TArray<FBatchedLine> Lines;
+};
@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartInterpolation.h"
+
+namespace
+{
+	// How quickly the offset follows deliveries slower than the fastest one
+	constexpr double ClockOffsetRecovery = 0.05;
+}
+
+void FGoKartClockOffset::Add(double LocalTime, double RemoteTime)
+{
+	const double NewOffset = LocalTime - RemoteTime;
+	if (!bIsSet || NewOffset < Offset)
+	{
+		Offset = NewOffset;
+		bIsSet = true;
+	}
+	else
+	{
+		Offset += (NewOffset - Offset) * ClockOffsetRecovery;
+	}
+}
+
+FGoKartSnapshot GoKartInterpolation::Sample(const FGoKartSnapshot& From, const FGoKartSnapshot& To, double Time)
+{
+	const float Duration = float(To.Time - From.Time);
+	const float Alpha = float(Time - From.Time) / Duration;
+
+	// Velocity is in m/s, tangents are cm over the whole segment
+	const FVector FromTangent{ From.Velocity * 100.f * Duration };
+	const FVector ToTangent{ To.Velocity * 100.f * Duration };
+
+	FGoKartSnapshot Result;
+	Result.Time = Time;
+	Result.Location = FMath::CubicInterp(From.Location, FromTangent, To.Location, ToTangent, Alpha);
+	Result.Rotation = FQuat::Slerp(From.Rotation, To.Rotation, Alpha);
+	Result.Velocity = FMath::Lerp(From.Velocity, To.Velocity, Alpha);
+	return Result;
+}
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FGoKartSnapshot
+{
+	double Time{};
+	FVector Location{ FVector::ZeroVector };
+	FQuat Rotation{ FQuat::Identity };
+	FVector Velocity{ FVector::ZeroVector }; // m/s
+};
+
+/**
+ * Offset from a remote clock to a local one, from pairs of (local receive time, remote send
+ * time). Follows the fastest delivery seen at once and slower ones gradually, so a late packet
+ * barely moves it while a genuine drift is still picked up.
+ */
+class FGoKartClockOffset
+{
+public:
+	void Reset() { bIsSet = false; }
+	void Add(double LocalTime, double RemoteTime);
+
+	bool IsSet() const { return bIsSet; }
+	double Get() const { return Offset; }
+
+private:
+	double Offset{};
+	bool bIsSet{};
+};
+
+// Shared by FGoKartSnapshotBuffer and FGoKartTransformHistory
+namespace GoKartInterpolation
+{
+	// Cubic Hermite location with the velocities as tangents, slerped rotation and lerped velocity at Time,
+	// which must lie between From.Time and To.Time
+	FGoKartSnapshot Sample(const FGoKartSnapshot& From, const FGoKartSnapshot& To, double Time);
+}
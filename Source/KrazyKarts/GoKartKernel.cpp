@@ -0,0 +1,213 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartKernel.h"
+
+#define GOKART_KERNEL_SSE (PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY)
+
+#if GOKART_KERNEL_SSE
+#include <xmmintrin.h>
+#endif
+
+void FGoKartKernelBatch::SetNum(int32 InNumKarts)
+{
+	NumKarts = InNumKarts;
+	const int32 Padded = Align(InNumKarts, GoKartKernel::LaneWidth);
+
+	TArray<float>* Lanes[] = {
+		&ForwardX, &ForwardY, &ForwardZ, &UpX, &UpY, &UpZ,
+		&Throttle, &Steering, &DeltaTime,
+		&InvMass, &MaxDrivingForce, &DragCoefficient, &RollingResistanceCoefficient, &NormalForceAcceleration, &MinTurningRadius,
+		&VelocityX, &VelocityY, &VelocityZ,
+		&RotationX, &RotationY, &RotationZ, &RotationW,
+		&LocationDeltaX, &LocationDeltaY, &LocationDeltaZ };
+	for (TArray<float>* Lane : Lanes)
+	{
+		Lane->SetNumUninitialized(Padded, false);
+		for (int32 Index = InNumKarts; Index < Padded; ++Index)
+		{
+			(*Lane)[Index] = 0.f;
+		}
+	}
+
+	// Any radius avoids dividing zero by zero in the padding
+	for (int32 Index = InNumKarts; Index < Padded; ++Index)
+	{
+		MinTurningRadius[Index] = 1.f;
+	}
+}
+
+void FGoKartKernelBatch::SetLane(int32 Index, const FGoKartSimConstants& Constants, const FQuat& Rotation, const FVector& Velocity, const FGoKartMove& Move)
+{
+	const FVector Forward{ Rotation.GetForwardVector() };
+	const FVector Up{ Rotation.GetUpVector() };
+	ForwardX[Index] = Forward.X;
+	ForwardY[Index] = Forward.Y;
+	ForwardZ[Index] = Forward.Z;
+	UpX[Index] = Up.X;
+	UpY[Index] = Up.Y;
+	UpZ[Index] = Up.Z;
+	Throttle[Index] = Move.Throttle;
+	Steering[Index] = Move.Steering;
+	DeltaTime[Index] = Move.DeltaTime;
+	InvMass[Index] = Constants.InvMass;
+	MaxDrivingForce[Index] = Constants.MaxDrivingForce;
+	DragCoefficient[Index] = Constants.DragCoefficient;
+	RollingResistanceCoefficient[Index] = Constants.RollingResistanceCoefficient;
+	NormalForceAcceleration[Index] = Constants.NormalForceAcceleration;
+	MinTurningRadius[Index] = Constants.MinTurningRadius;
+	VelocityX[Index] = Velocity.X;
+	VelocityY[Index] = Velocity.Y;
+	VelocityZ[Index] = Velocity.Z;
+}
+
+namespace
+{
+	void IntegrateScalar(FGoKartKernelBatch& B, int32 Begin, int32 End)
+	{
+		for (int32 Index = Begin; Index < End; ++Index)
+		{
+			FGoKartSimConstants Constants;
+			Constants.InvMass = B.InvMass[Index];
+			Constants.MaxDrivingForce = B.MaxDrivingForce[Index];
+			Constants.DragCoefficient = B.DragCoefficient[Index];
+			Constants.RollingResistanceCoefficient = B.RollingResistanceCoefficient[Index];
+			Constants.NormalForceAcceleration = B.NormalForceAcceleration[Index];
+			Constants.MinTurningRadius = B.MinTurningRadius[Index];
+
+			FGoKartMove Move;
+			Move.Throttle = B.Throttle[Index];
+			Move.Steering = B.Steering[Index];
+			Move.DeltaTime = B.DeltaTime[Index];
+
+			FVector Velocity{ B.GetVelocity(Index) };
+			FQuat RotationDelta;
+			FVector LocationDelta;
+			GoKartSimulation::IntegrateMove(Constants, FVector(B.ForwardX[Index], B.ForwardY[Index], B.ForwardZ[Index]), FVector(B.UpX[Index], B.UpY[Index], B.UpZ[Index]),
+				Move, Velocity, RotationDelta, LocationDelta);
+
+			B.VelocityX[Index] = Velocity.X;
+			B.VelocityY[Index] = Velocity.Y;
+			B.VelocityZ[Index] = Velocity.Z;
+			B.RotationX[Index] = RotationDelta.X;
+			B.RotationY[Index] = RotationDelta.Y;
+			B.RotationZ[Index] = RotationDelta.Z;
+			B.RotationW[Index] = RotationDelta.W;
+			B.LocationDeltaX[Index] = LocationDelta.X;
+			B.LocationDeltaY[Index] = LocationDelta.Y;
+			B.LocationDeltaZ[Index] = LocationDelta.Z;
+		}
+	}
+
+#if GOKART_KERNEL_SSE
+	// Mirrors GoKartSimulation::IntegrateMove line for line. SSE add, mul and div are
+	// correctly rounded like their scalar counterparts, so keep any change in step with it.
+	// This relies on the scalar code not being contracted into FMA, which the default x64 targets don't enable.
+	void IntegrateSse(FGoKartKernelBatch& B)
+	{
+		const __m128 Two = _mm_set1_ps(2.f);
+		const __m128 Half = _mm_set1_ps(0.5f);
+		const __m128 Hundred = _mm_set1_ps(100.f);
+		const __m128 SmallNumber = _mm_set1_ps(SMALL_NUMBER);
+		const __m128 SignBit = _mm_set1_ps(-0.f);
+
+		for (int32 Index = 0; Index < B.NumPadded(); Index += GoKartKernel::LaneWidth)
+		{
+			__m128 VX = _mm_loadu_ps(&B.VelocityX[Index]);
+			__m128 VY = _mm_loadu_ps(&B.VelocityY[Index]);
+			__m128 VZ = _mm_loadu_ps(&B.VelocityZ[Index]);
+			const __m128 FwdX = _mm_loadu_ps(&B.ForwardX[Index]);
+			const __m128 FwdY = _mm_loadu_ps(&B.ForwardY[Index]);
+			const __m128 FwdZ = _mm_loadu_ps(&B.ForwardZ[Index]);
+			const __m128 DeltaTime = _mm_loadu_ps(&B.DeltaTime[Index]);
+			const __m128 InvMass = _mm_loadu_ps(&B.InvMass[Index]);
+
+			// GetSafeNormal: FMath::InvSqrt per lane, since the engine's refined estimate is what the scalar path gets.
+			// A unit velocity scales by exactly one, and lanes too slow to normalise are masked to +0.
+			const __m128 SpeedSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(VX, VX), _mm_mul_ps(VY, VY)), _mm_mul_ps(VZ, VZ));
+			alignas(16) float SpeedsSquared[4];
+			alignas(16) float Scales[4];
+			_mm_store_ps(SpeedsSquared, SpeedSquared);
+			for (int32 Lane = 0; Lane < 4; ++Lane)
+			{
+				Scales[Lane] = SpeedsSquared[Lane] == 1.f || SpeedsSquared[Lane] < SMALL_NUMBER ? 1.f : FMath::InvSqrt(SpeedsSquared[Lane]);
+			}
+			const __m128 Scale = _mm_load_ps(Scales);
+			const __m128 IsMoving = _mm_cmpge_ps(SpeedSquared, SmallNumber);
+			const __m128 NegDirX = _mm_xor_ps(_mm_and_ps(IsMoving, _mm_mul_ps(VX, Scale)), SignBit);
+			const __m128 NegDirY = _mm_xor_ps(_mm_and_ps(IsMoving, _mm_mul_ps(VY, Scale)), SignBit);
+			const __m128 NegDirZ = _mm_xor_ps(_mm_and_ps(IsMoving, _mm_mul_ps(VZ, Scale)), SignBit);
+
+			// Driving force plus air resistance plus rolling resistance, summed in that order
+			const __m128 MaxDrivingForce = _mm_loadu_ps(&B.MaxDrivingForce[Index]);
+			const __m128 Throttle = _mm_loadu_ps(&B.Throttle[Index]);
+			const __m128 DragCoefficient = _mm_loadu_ps(&B.DragCoefficient[Index]);
+			const __m128 RollingResistanceCoefficient = _mm_loadu_ps(&B.RollingResistanceCoefficient[Index]);
+			const __m128 NormalForceAcceleration = _mm_loadu_ps(&B.NormalForceAcceleration[Index]);
+			const auto Force = [&](__m128 Fwd, __m128 NegDir)
+			{
+				const __m128 Driving = _mm_mul_ps(_mm_mul_ps(Fwd, MaxDrivingForce), Throttle);
+				const __m128 Air = _mm_mul_ps(_mm_mul_ps(NegDir, SpeedSquared), DragCoefficient);
+				const __m128 Rolling = _mm_mul_ps(_mm_mul_ps(NegDir, RollingResistanceCoefficient), NormalForceAcceleration);
+				return _mm_add_ps(_mm_add_ps(Driving, Air), Rolling);
+			};
+			VX = _mm_add_ps(VX, _mm_mul_ps(_mm_mul_ps(Force(FwdX, NegDirX), InvMass), DeltaTime));
+			VY = _mm_add_ps(VY, _mm_mul_ps(_mm_mul_ps(Force(FwdY, NegDirY), InvMass), DeltaTime));
+			VZ = _mm_add_ps(VZ, _mm_mul_ps(_mm_mul_ps(Force(FwdZ, NegDirZ), InvMass), DeltaTime));
+
+			// Turning
+			const __m128 DeltaLocation = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(FwdX, VX), _mm_mul_ps(FwdY, VY)), _mm_mul_ps(FwdZ, VZ)), DeltaTime);
+			const __m128 RotationAngle = _mm_mul_ps(_mm_div_ps(DeltaLocation, _mm_loadu_ps(&B.MinTurningRadius[Index])), _mm_loadu_ps(&B.Steering[Index]));
+			const __m128 HalfAngle = _mm_mul_ps(Half, RotationAngle);
+
+			// FMath::SinCos per lane; a vector approximation would not match the scalar path
+			alignas(16) float Angles[4];
+			alignas(16) float Sines[4];
+			alignas(16) float Cosines[4];
+			_mm_store_ps(Angles, HalfAngle);
+			for (int32 Lane = 0; Lane < 4; ++Lane)
+			{
+				FMath::SinCos(&Sines[Lane], &Cosines[Lane], Angles[Lane]);
+			}
+			const __m128 Sin = _mm_load_ps(Sines);
+			const __m128 QX = _mm_mul_ps(Sin, _mm_loadu_ps(&B.UpX[Index]));
+			const __m128 QY = _mm_mul_ps(Sin, _mm_loadu_ps(&B.UpY[Index]));
+			const __m128 QZ = _mm_mul_ps(Sin, _mm_loadu_ps(&B.UpZ[Index]));
+			const __m128 QW = _mm_load_ps(Cosines);
+
+			const __m128 TX = _mm_mul_ps(Two, _mm_sub_ps(_mm_mul_ps(QY, VZ), _mm_mul_ps(QZ, VY)));
+			const __m128 TY = _mm_mul_ps(Two, _mm_sub_ps(_mm_mul_ps(QZ, VX), _mm_mul_ps(QX, VZ)));
+			const __m128 TZ = _mm_mul_ps(Two, _mm_sub_ps(_mm_mul_ps(QX, VY), _mm_mul_ps(QY, VX)));
+			const __m128 NewVX = _mm_add_ps(_mm_add_ps(VX, _mm_mul_ps(QW, TX)), _mm_sub_ps(_mm_mul_ps(QY, TZ), _mm_mul_ps(QZ, TY)));
+			const __m128 NewVY = _mm_add_ps(_mm_add_ps(VY, _mm_mul_ps(QW, TY)), _mm_sub_ps(_mm_mul_ps(QZ, TX), _mm_mul_ps(QX, TZ)));
+			const __m128 NewVZ = _mm_add_ps(_mm_add_ps(VZ, _mm_mul_ps(QW, TZ)), _mm_sub_ps(_mm_mul_ps(QX, TY), _mm_mul_ps(QY, TX)));
+
+			_mm_storeu_ps(&B.VelocityX[Index], NewVX);
+			_mm_storeu_ps(&B.VelocityY[Index], NewVY);
+			_mm_storeu_ps(&B.VelocityZ[Index], NewVZ);
+			_mm_storeu_ps(&B.RotationX[Index], QX);
+			_mm_storeu_ps(&B.RotationY[Index], QY);
+			_mm_storeu_ps(&B.RotationZ[Index], QZ);
+			_mm_storeu_ps(&B.RotationW[Index], QW);
+			_mm_storeu_ps(&B.LocationDeltaX[Index], _mm_mul_ps(_mm_mul_ps(NewVX, DeltaTime), Hundred));
+			_mm_storeu_ps(&B.LocationDeltaY[Index], _mm_mul_ps(_mm_mul_ps(NewVY, DeltaTime), Hundred));
+			_mm_storeu_ps(&B.LocationDeltaZ[Index], _mm_mul_ps(_mm_mul_ps(NewVZ, DeltaTime), Hundred));
+		}
+	}
+#endif // GOKART_KERNEL_SSE
+}
+
+bool GoKartKernel::IsSimdSupported()
+{
+	return GOKART_KERNEL_SSE != 0;
+}
+
+void GoKartKernel::Integrate(FGoKartKernelBatch& Batch, bool bAllowSimd)
+{
+#if GOKART_KERNEL_SSE
+	if (bAllowSimd)
+	{
+		IntegrateSse(Batch);
+		return;
+	}
+#endif // GOKART_KERNEL_SSE
+	IntegrateScalar(Batch, 0, Batch.Num());
+}
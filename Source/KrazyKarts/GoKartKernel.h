@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartSimulation.h"
+
+/**
+ * Structure-of-arrays input and output of GoKartKernel::Integrate, one lane per kart and
+ * padded to a whole number of SIMD registers. Padding lanes are zeroed (apart from a
+ * unit turning radius) and integrate to zero.
+ */
+struct KRAZYKARTS_API FGoKartKernelBatch
+{
+	// Sizes every lane array for NumKarts and zeroes the padding. Keeps the allocation when shrinking.
+	void SetNum(int32 NumKarts);
+	int32 Num() const { return NumKarts; }
+	int32 NumPadded() const { return VelocityX.Num(); }
+
+	// Fills lane Index from a kart's constants, orientation, velocity and move
+	void SetLane(int32 Index, const FGoKartSimConstants& Constants, const FQuat& Rotation, const FVector& Velocity, const FGoKartMove& Move);
+
+	FVector GetVelocity(int32 Index) const { return FVector(VelocityX[Index], VelocityY[Index], VelocityZ[Index]); }
+	FQuat GetRotationDelta(int32 Index) const { return FQuat(RotationX[Index], RotationY[Index], RotationZ[Index], RotationW[Index]); }
+	FVector GetLocationDelta(int32 Index) const { return FVector(LocationDeltaX[Index], LocationDeltaY[Index], LocationDeltaZ[Index]); }
+
+	// Inputs
+	TArray<float> ForwardX, ForwardY, ForwardZ;
+	TArray<float> UpX, UpY, UpZ;
+	TArray<float> Throttle, Steering, DeltaTime;
+	TArray<float> InvMass, MaxDrivingForce, DragCoefficient, RollingResistanceCoefficient, NormalForceAcceleration, MinTurningRadius;
+
+	// Read and written
+	TArray<float> VelocityX, VelocityY, VelocityZ;
+
+	// Outputs, as returned by GoKartSimulation::IntegrateMove
+	TArray<float> RotationX, RotationY, RotationZ, RotationW;
+	TArray<float> LocationDeltaX, LocationDeltaY, LocationDeltaZ;
+
+private:
+	int32 NumKarts{};
+};
+
+/**
+ * GoKartSimulation::IntegrateMove for many karts at once. The SIMD path runs 4 karts per
+ * instruction and performs the same float operations in the same order as the scalar code,
+ * so both give bit-identical results to the reference GoKartSimulation::Step; GoKartBenchmark
+ * -Verify checks this.
+ */
+namespace GoKartKernel
+{
+	constexpr int32 LaneWidth = 4;
+
+	// Whether Integrate can take the SIMD path on this platform
+	KRAZYKARTS_API bool IsSimdSupported();
+
+	// Integrates one move in every lane of the batch
+	KRAZYKARTS_API void Integrate(FGoKartKernelBatch& Batch, bool bAllowSimd = true);
+}
@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartLagCompensationSubsystem.h"
+
+#include "GoKart.h"
+#include "KrazyKarts.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	TAutoConsoleVariable<float> CVarLagCompensationWindow(
+		TEXT("kk.Net.LagCompensationWindow"),
+		1.f,
+		TEXT("Seconds of server kart history kept for lag-compensated queries. Also capped by the history capacity."));
+
+	TAutoConsoleVariable<int32> CVarLagCompensationDebug(
+		TEXT("kk.Net.LagCompensationDebug"),
+		0,
+		TEXT("Rewind every other kart to what each client saw when it sent its moves, twice a second per client, and log (Verbose) and draw the difference from now."));
+
+	// Samples per kart, one per server frame: a second at up to 128 Hz, about 6 KB
+	constexpr int32 HistoryCapacity = 128;
+
+	// Real seconds between debug rewinds for one requester
+	constexpr double DebugRewindInterval = 0.5;
+}
+
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Rewind"), STAT_GoKartRewind, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewind Queries"), STAT_GoKartRewindQueries, STATGROUP_KrazyKarts);
+
+bool UGoKartLagCompensationSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && World->GetNetMode() != NM_Client;
+}
+
+void UGoKartLagCompensationSubsystem::Register(const AGoKart* Kart)
+{
+	Histories.FindOrAdd(Kart).Init(HistoryCapacity);
+}
+
+void UGoKartLagCompensationSubsystem::Unregister(const AGoKart* Kart)
+{
+	Histories.Remove(Kart);
+	LastDebugRewindTimes.Remove(Kart);
+}
+
+void UGoKartLagCompensationSubsystem::Record(const AGoKart* Kart, const FVector& Location, const FQuat& Rotation, const FVector& Velocity)
+{
+	if (FGoKartTransformHistory* History = Histories.Find(Kart))
+	{
+		History->Add(GetWorld()->GetTimeSeconds(), Location, Rotation, Velocity);
+	}
+}
+
+void UGoKartLagCompensationSubsystem::RecordMoveReceived(const AGoKart* Kart, float ClientTime)
+{
+	if (FGoKartTransformHistory* History = Histories.Find(Kart))
+	{
+		History->AddClientTime(GetWorld()->GetTimeSeconds(), ClientTime);
+
+		if (CVarLagCompensationDebug.GetValueOnGameThread() != 0)
+		{
+			QueueDebugRewinds(Kart, ClientTime);
+		}
+	}
+}
+
+double UGoKartLagCompensationSubsystem::GetServerTime(const AGoKart* Requester, const AGoKart* Target, double ClientTime) const
+{
+	const FGoKartTransformHistory* History = Histories.Find(Requester);
+	if (!History || !History->HasClockOffset())
+	{
+		return GetWorld()->GetTimeSeconds();
+	}
+
+	// The offset was measured at the fastest delivery, so the round trip is the connection's average over it
+	const UNetConnection* Connection = Requester->GetNetConnection();
+	const double RoundTrip = Connection ? Connection->AvgLag : 0.;
+	return History->ToServerTime(ClientTime) - RoundTrip - Target->GetSnapshotInterpolationDelay();
+}
+
+void UGoKartLagCompensationSubsystem::QueueDebugRewinds(const AGoKart* Requester, float ClientTime)
+{
+	const double RealTime = FPlatformTime::Seconds();
+	double& LastRewindTime = LastDebugRewindTimes.FindOrAdd(Requester, -DebugRewindInterval);
+	if (RealTime - LastRewindTime < DebugRewindInterval)
+	{
+		return;
+	}
+	LastRewindTime = RealTime;
+
+	const FString RequesterName{ Requester->GetName() };
+	for (const TPair<const AGoKart*, FGoKartTransformHistory>& Pair : Histories)
+	{
+		if (Pair.Key == Requester)
+		{
+			continue;
+		}
+
+		const double ServerTime = GetServerTime(Requester, Pair.Key, ClientTime);
+		TWeakObjectPtr<const AGoKart> Target{ Pair.Key };
+		QueueRewind(Pair.Key, ServerTime, [this, Target, RequesterName, ServerTime](const FGoKartRewindQuery& Query)
+		{
+			if (!Target.IsValid())
+			{
+				return;
+			}
+
+			const FVector CurrentLocation{ Target->GetActorLocation() };
+			UE_LOG(LogKrazyKarts, Verbose, TEXT("%s saw %s %.0f ms ago at %s, %.1f cm from now%s"),
+				*RequesterName, *Target->GetName(), (GetWorld()->GetTimeSeconds() - ServerTime) * 1000.,
+				*Query.Result.Location.ToString(), FVector::Dist(Query.Result.Location, CurrentLocation),
+				Query.bInHistory ? TEXT("") : TEXT(" (outside history)"));
+
+			if (GetWorld()->GetNetMode() != NM_DedicatedServer)
+			{
+				DrawDebugBox(GetWorld(), Query.Result.Location, FVector(50.f), Query.Result.Rotation,
+					Query.bInHistory ? FColor::Cyan : FColor::Red, false, DebugRewindInterval);
+			}
+		});
+	}
+}
+
+void UGoKartLagCompensationSubsystem::Rewind(TArrayView<FGoKartRewindQuery> Queries)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartRewind);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, Rewind);
+	INC_DWORD_STAT_BY(STAT_GoKartRewindQueries, Queries.Num());
+
+	QueryOrder.Reset();
+	for (int32 Index = 0; Index < Queries.Num(); ++Index)
+	{
+		QueryOrder.Add(Index);
+	}
+	QueryOrder.Sort([&Queries](int32 A, int32 B)
+	{
+		return Queries[A].Kart != Queries[B].Kart ? Queries[A].Kart < Queries[B].Kart : Queries[A].ServerTime < Queries[B].ServerTime;
+	});
+
+	const AGoKart* CurrentKart = nullptr;
+	const FGoKartTransformHistory* History = nullptr;
+	int32 Cursor = 0;
+	for (int32 Index : QueryOrder)
+	{
+		FGoKartRewindQuery& Query = Queries[Index];
+		if (Query.Kart != CurrentKart)
+		{
+			CurrentKart = Query.Kart;
+			History = Histories.Find(CurrentKart);
+			Cursor = 0;
+		}
+		Query.bInHistory = History && History->Sample(Query.ServerTime, Query.Result, Cursor);
+	}
+}
+
+void UGoKartLagCompensationSubsystem::QueueRewind(const AGoKart* Kart, double ServerTime, TFunction<void(const FGoKartRewindQuery&)>&& OnRewound)
+{
+	FGoKartRewindQuery& Query = QueuedQueries.AddDefaulted_GetRef();
+	Query.Kart = Kart;
+	Query.ServerTime = ServerTime;
+	QueuedCallbacks.Add(MoveTemp(OnRewound));
+}
+
+bool UGoKartLagCompensationSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Histories.Num() > 0;
+}
+
+TStatId UGoKartLagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGoKartLagCompensationSubsystem, STATGROUP_Tickables);
+}
+
+void UGoKartLagCompensationSubsystem::Tick(float DeltaTime)
+{
+	const double OldestTime = GetWorld()->GetTimeSeconds() - CVarLagCompensationWindow.GetValueOnGameThread();
+	for (TPair<const AGoKart*, FGoKartTransformHistory>& Pair : Histories)
+	{
+		Pair.Value.Trim(OldestTime);
+	}
+
+	if (QueuedQueries.Num() == 0)
+	{
+		return;
+	}
+
+	// Callbacks may queue queries for the next tick
+	TArray<FGoKartRewindQuery> Queries{ MoveTemp(QueuedQueries) };
+	TArray<TFunction<void(const FGoKartRewindQuery&)>> Callbacks{ MoveTemp(QueuedCallbacks) };
+	QueuedQueries.Reset();
+	QueuedCallbacks.Reset();
+
+	Rewind(Queries);
+	for (int32 Index = 0; Index < Queries.Num(); ++Index)
+	{
+		Callbacks[Index](Queries[Index]);
+	}
+}
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "GoKartTransformHistory.h"
+#include "GoKartLagCompensationSubsystem.generated.h"
+
+class AGoKart;
+
+// One "where was Kart at ServerTime" question, answered in place by Rewind
+struct FGoKartRewindQuery
+{
+	const AGoKart* Kart{};
+	double ServerTime{};
+
+	// False when the kart has no history or ServerTime is outside it; Result then holds the nearest sample
+	bool bInHistory{};
+	FGoKartSnapshot Result;
+};
+
+/**
+ * Server-side history of every kart's transform and velocity for lag-compensated contact and
+ * pickup checks. Karts record one sample per server frame when their state is updated, and
+ * samples older than kk.Net.LagCompensationWindow seconds are dropped, so memory per kart is
+ * fixed. Rewind answers any number of queries in one pass: they are sorted by kart and time,
+ * and each kart's history is walked once. Queries can also be queued during the frame and are
+ * then answered together in the subsystem's tick.
+ *
+ * With kk.Net.LagCompensationDebug 1, every kart's moves rewind all the other karts to what its
+ * client was showing, logging and drawing how far that is from where they are now.
+ */
+UCLASS()
+class UGoKartLagCompensationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	void Register(const AGoKart* Kart);
+	void Unregister(const AGoKart* Kart);
+
+	// Called by the server whenever a kart's authoritative state changes
+	void Record(const AGoKart* Kart, const FVector& Location, const FQuat& Rotation, const FVector& Velocity);
+
+	// Called by the server as soon as a move from Kart's client arrives, before it is queued
+	void RecordMoveReceived(const AGoKart* Kart, float ClientTime);
+
+	// Server time of the Target state Requester's client was drawing when its clock read ClientTime, e.g. the
+	// TimeStamp of one of its moves: when that move arrived, less the round trip (the move's way here and the
+	// drawn state's way there) and the delay Target is interpolated behind on clients
+	double GetServerTime(const AGoKart* Requester, const AGoKart* Target, double ClientTime) const;
+
+	void Rewind(TArrayView<FGoKartRewindQuery> Queries);
+
+	// Answered with all other queued queries in the next tick
+	void QueueRewind(const AGoKart* Kart, double ServerTime, TFunction<void(const FGoKartRewindQuery&)>&& OnRewound);
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+private:
+	// kk.Net.LagCompensationDebug: rewinds every other kart to what Requester's client saw at ClientTime
+	void QueueDebugRewinds(const AGoKart* Requester, float ClientTime);
+
+	TMap<const AGoKart*, FGoKartTransformHistory> Histories;
+
+	TArray<FGoKartRewindQuery> QueuedQueries;
+	TArray<TFunction<void(const FGoKartRewindQuery&)>> QueuedCallbacks;
+
+	// Reused by Rewind
+	TArray<int32> QueryOrder;
+
+	// Real time of each kart's last debug rewind
+	TMap<const AGoKart*, double> LastDebugRewindTimes;
+};
@@ -0,0 +1,294 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartMoveLog.h"
+
+#include "KrazyKarts.h"
+#include "GoKartNetSerialization.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/RunnableThread.h"
+
+namespace
+{
+	constexpr uint32 MoveLogMagic = 0x4C4D4B4B; // "KKML"
+	constexpr uint32 MoveLogVersion = 2;
+
+	void WriteVarInt(uint64 Value, TArray<uint8>& Out)
+	{
+		while (Value >= 0x80)
+		{
+			Out.Add(uint8(Value) | 0x80);
+			Value >>= 7;
+		}
+		Out.Add(uint8(Value));
+	}
+
+	uint32 GetFloatBits(float Value)
+	{
+		uint32 Bits;
+		FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+		return Bits;
+	}
+
+	// Little endian, whatever the platform
+	void WriteUInt32(uint32 Value, TArray<uint8>& Out)
+	{
+		for (int32 Shift = 0; Shift < 32; Shift += 8)
+		{
+			Out.Add(uint8(Value >> Shift));
+		}
+	}
+
+	void WriteFloat(float Value, TArray<uint8>& Out)
+	{
+		WriteUInt32(GetFloatBits(Value), Out);
+	}
+
+	void WriteVector(const FVector& Value, TArray<uint8>& Out)
+	{
+		WriteFloat(Value.X, Out);
+		WriteFloat(Value.Y, Out);
+		WriteFloat(Value.Z, Out);
+	}
+
+	uint64 ZigZag(int64 Value)
+	{
+		return (uint64(Value) << 1) ^ uint64(Value >> 63);
+	}
+
+	int64 UnZigZag(uint64 Value)
+	{
+		return int64(Value >> 1) ^ -int64(Value & 1);
+	}
+}
+
+void FGoKartMoveLogEncoder::WriteHeader(TArray<uint8>& Out)
+{
+	WriteUInt32(MoveLogMagic, Out);
+	WriteUInt32(MoveLogVersion, Out);
+}
+
+void FGoKartMoveLogEncoder::Encode(const FGoKartMoveLogRecord& Record, TArray<uint8>& Out)
+{
+	Out.Add(uint8(Record.Type));
+	WriteVarInt(Record.KartId, Out);
+
+	// Received moves are already quantized, so the axes and delta time round-trip exactly
+	FGoKartMove& Previous = PreviousMoves.FindOrAdd(Record.KartId, FGoKartMove{});
+	const FGoKartMove& Move = Record.Move;
+	WriteVarInt(ZigZag(int64(Move.Sequence) - int64(Previous.Sequence)), Out);
+	Out.Add(GoKartNet::QuantizeAxis(Move.Throttle));
+	Out.Add(GoKartNet::QuantizeAxis(Move.Steering));
+	WriteVarInt(GoKartNet::QuantizeDeltaTime(Move.DeltaTime), Out);
+	WriteVarInt(GetFloatBits(Move.TimeStamp) ^ GetFloatBits(Previous.TimeStamp), Out);
+	Previous = Move;
+
+	if (Record.Type == EGoKartMoveLogRecordType::Keyframe)
+	{
+		WriteVector(Record.State.Location, Out);
+		WriteFloat(Record.State.Rotation.X, Out);
+		WriteFloat(Record.State.Rotation.Y, Out);
+		WriteFloat(Record.State.Rotation.Z, Out);
+		WriteFloat(Record.State.Rotation.W, Out);
+		WriteVector(Record.State.Velocity, Out);
+		WriteFloat(Record.Constants.InvMass, Out);
+		WriteFloat(Record.Constants.MaxDrivingForce, Out);
+		WriteFloat(Record.Constants.DragCoefficient, Out);
+		WriteFloat(Record.Constants.RollingResistanceCoefficient, Out);
+		WriteFloat(Record.Constants.NormalForceAcceleration, Out);
+		WriteFloat(Record.Constants.MinTurningRadius, Out);
+	}
+}
+
+bool FGoKartMoveLogReader::Open(TArrayView<const uint8> InData)
+{
+	Data = InData;
+	Offset = 0;
+	bCorrupt = false;
+	PreviousMoves.Reset();
+
+	uint32 Magic, Version;
+	if (!ReadUInt32(Magic) || !ReadUInt32(Version) || Magic != MoveLogMagic || Version != MoveLogVersion)
+	{
+		bCorrupt = true;
+		return false;
+	}
+	return true;
+}
+
+bool FGoKartMoveLogReader::Next(FGoKartMoveLogRecord& OutRecord)
+{
+	if (bCorrupt || Offset >= Data.Num())
+	{
+		return false;
+	}
+
+	uint8 Type, Throttle, Steering;
+	uint64 KartId, SequenceDelta, DeltaTimeMs, TimeStampBits;
+	if (!ReadByte(Type) || Type > uint8(EGoKartMoveLogRecordType::Keyframe) || !ReadVarInt(KartId)
+		|| !ReadVarInt(SequenceDelta) || !ReadByte(Throttle) || !ReadByte(Steering) || !ReadVarInt(DeltaTimeMs) || !ReadVarInt(TimeStampBits))
+	{
+		bCorrupt = true;
+		return false;
+	}
+
+	FGoKartMove& Previous = PreviousMoves.FindOrAdd(uint32(KartId), FGoKartMove{});
+	FGoKartMove& Move = OutRecord.Move;
+	Move.Sequence = uint32(int64(Previous.Sequence) + UnZigZag(SequenceDelta));
+	Move.Throttle = GoKartNet::DequantizeAxis(Throttle);
+	Move.Steering = GoKartNet::DequantizeAxis(Steering);
+	Move.DeltaTime = GoKartNet::DequantizeDeltaTime(uint32(DeltaTimeMs));
+	const uint32 Bits = uint32(TimeStampBits) ^ GetFloatBits(Previous.TimeStamp);
+	FMemory::Memcpy(&Move.TimeStamp, &Bits, sizeof(Bits));
+	Previous = Move;
+
+	OutRecord.Type = EGoKartMoveLogRecordType(Type);
+	OutRecord.KartId = uint32(KartId);
+
+	if (OutRecord.Type == EGoKartMoveLogRecordType::Keyframe)
+	{
+		FGoKartSimState& State = OutRecord.State;
+		FGoKartSimConstants& Constants = OutRecord.Constants;
+		if (!ReadFloat(State.Location.X) || !ReadFloat(State.Location.Y) || !ReadFloat(State.Location.Z)
+			|| !ReadFloat(State.Rotation.X) || !ReadFloat(State.Rotation.Y) || !ReadFloat(State.Rotation.Z) || !ReadFloat(State.Rotation.W)
+			|| !ReadFloat(State.Velocity.X) || !ReadFloat(State.Velocity.Y) || !ReadFloat(State.Velocity.Z)
+			|| !ReadFloat(Constants.InvMass) || !ReadFloat(Constants.MaxDrivingForce) || !ReadFloat(Constants.DragCoefficient)
+			|| !ReadFloat(Constants.RollingResistanceCoefficient) || !ReadFloat(Constants.NormalForceAcceleration) || !ReadFloat(Constants.MinTurningRadius))
+		{
+			bCorrupt = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FGoKartMoveLogReader::ReadByte(uint8& OutValue)
+{
+	if (Offset >= Data.Num())
+	{
+		return false;
+	}
+	OutValue = Data[Offset++];
+	return true;
+}
+
+bool FGoKartMoveLogReader::ReadVarInt(uint64& OutValue)
+{
+	OutValue = 0;
+	for (int32 Shift = 0; Shift < 64; Shift += 7)
+	{
+		uint8 Byte;
+		if (!ReadByte(Byte))
+		{
+			return false;
+		}
+		OutValue |= uint64(Byte & 0x7F) << Shift;
+		if ((Byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FGoKartMoveLogReader::ReadUInt32(uint32& OutValue)
+{
+	if (Offset + 4 > Data.Num())
+	{
+		return false;
+	}
+	OutValue = uint32(Data[Offset]) | uint32(Data[Offset + 1]) << 8 | uint32(Data[Offset + 2]) << 16 | uint32(Data[Offset + 3]) << 24;
+	Offset += 4;
+	return true;
+}
+
+bool FGoKartMoveLogReader::ReadFloat(float& OutValue)
+{
+	uint32 Bits;
+	if (!ReadUInt32(Bits))
+	{
+		return false;
+	}
+	FMemory::Memcpy(&OutValue, &Bits, sizeof(Bits));
+	return true;
+}
+
+FGoKartMoveLogWriter::FGoKartMoveLogWriter(const FString& InFilename)
+	: Filename(InFilename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+	File.Reset(PlatformFile.OpenWrite(*Filename));
+	if (!File)
+	{
+		UE_LOG(LogKrazyKarts, Error, TEXT("Could not open move log %s"), *Filename);
+		return;
+	}
+
+	FGoKartMoveLogEncoder::WriteHeader(Buffer);
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool();
+	Thread = FRunnableThread::Create(this, TEXT("GoKartMoveLogWriter"), 0, TPri_BelowNormal);
+}
+
+FGoKartMoveLogWriter::~FGoKartMoveLogWriter()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+	}
+	if (WorkEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	}
+	if (File)
+	{
+		File->Flush();
+		UE_LOG(LogKrazyKarts, Display, TEXT("Closed move log %s: %lld records, %lld bytes"), *Filename, NumRecordsWritten, NumBytesWritten);
+	}
+}
+
+void FGoKartMoveLogWriter::Enqueue(TArray<FGoKartMoveLogRecord>&& Records)
+{
+	if (Thread && Records.Num() > 0)
+	{
+		Queue.Enqueue(MoveTemp(Records));
+		WorkEvent->Trigger();
+	}
+}
+
+uint32 FGoKartMoveLogWriter::Run()
+{
+	while (!bStopping)
+	{
+		WorkEvent->Wait();
+		WriteQueued();
+	}
+	// Whatever the game thread queued before Stop
+	WriteQueued();
+	return 0;
+}
+
+void FGoKartMoveLogWriter::Stop()
+{
+	bStopping = true;
+	WorkEvent->Trigger();
+}
+
+void FGoKartMoveLogWriter::WriteQueued()
+{
+	TArray<FGoKartMoveLogRecord> Records;
+	while (Queue.Dequeue(Records))
+	{
+		for (const FGoKartMoveLogRecord& Record : Records)
+		{
+			Encoder.Encode(Record, Buffer);
+		}
+		NumRecordsWritten += Records.Num();
+	}
+
+	if (Buffer.Num() > 0)
+	{
+		File->Write(Buffer.GetData(), Buffer.Num());
+		NumBytesWritten += Buffer.Num();
+		Buffer.Reset();
+	}
+}
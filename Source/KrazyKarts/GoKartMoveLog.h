@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "GoKartSimulation.h"
+
+class IFileHandle;
+
+/**
+ * Binary log of the moves a server received, with periodic state keyframes.
+ *
+ * The file is an 8 byte header followed by records appended in arrival order. Moves are
+ * delta-encoded against the previous move of the same kart: the sequence step, the two
+ * 8 bit axes and millisecond delta time exactly as they came over the network, and the
+ * time stamp bits XORed with the previous ones, typically 9 bytes a move. Keyframes carry
+ * the full server state and the kart's simulation constants, so a log can be replayed
+ * without the map or the kart Blueprint.
+ */
+enum class EGoKartMoveLogRecordType : uint8
+{
+	Move,
+	Keyframe,
+};
+
+struct FGoKartMoveLogRecord
+{
+	EGoKartMoveLogRecordType Type{ EGoKartMoveLogRecordType::Move };
+	uint32 KartId{};
+
+	// For a keyframe, the last move included in State
+	FGoKartMove Move{};
+
+	// Keyframes only
+	FGoKartSimState State;
+	FGoKartSimConstants Constants;
+};
+
+// Turns records into file bytes. Keeps the previous move of every kart, so one encoder per file.
+class KRAZYKARTS_API FGoKartMoveLogEncoder
+{
+public:
+	static void WriteHeader(TArray<uint8>& Out);
+
+	void Encode(const FGoKartMoveLogRecord& Record, TArray<uint8>& Out);
+
+private:
+	TMap<uint32, FGoKartMove> PreviousMoves;
+};
+
+// Reads records back from a whole file in memory, usually a mapped region.
+class KRAZYKARTS_API FGoKartMoveLogReader
+{
+public:
+	// False if Data does not start with a supported header
+	bool Open(TArrayView<const uint8> InData);
+
+	// False at the end of the data or on a truncated or corrupt record, see IsCorrupt
+	bool Next(FGoKartMoveLogRecord& OutRecord);
+
+	bool IsCorrupt() const { return bCorrupt; }
+
+private:
+	bool ReadByte(uint8& OutValue);
+	bool ReadVarInt(uint64& OutValue);
+	bool ReadUInt32(uint32& OutValue);
+	bool ReadFloat(float& OutValue);
+
+	TArrayView<const uint8> Data;
+	int32 Offset{};
+	bool bCorrupt{};
+	TMap<uint32, FGoKartMove> PreviousMoves;
+};
+
+// Appends records to a log file from its own thread, so encoding and file IO stay off the game thread.
+class KRAZYKARTS_API FGoKartMoveLogWriter : public FRunnable
+{
+public:
+	// Creates the file and starts the thread, check IsOpen
+	explicit FGoKartMoveLogWriter(const FString& InFilename);
+
+	// Writes everything still queued and closes the file
+	virtual ~FGoKartMoveLogWriter();
+
+	bool IsOpen() const { return File.IsValid(); }
+	const FString& GetFilename() const { return Filename; }
+
+	// Game thread only
+	void Enqueue(TArray<FGoKartMoveLogRecord>&& Records);
+
+	// Begin FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	// End FRunnable interface
+
+private:
+	void WriteQueued();
+
+	FString Filename;
+	TUniquePtr<IFileHandle> File;
+	TQueue<TArray<FGoKartMoveLogRecord>, EQueueMode::Spsc> Queue;
+	FEvent* WorkEvent{};
+	FRunnableThread* Thread{};
+	FThreadSafeBool bStopping;
+
+	// Writer thread only
+	FGoKartMoveLogEncoder Encoder;
+	TArray<uint8> Buffer;
+	int64 NumBytesWritten{};
+	int64 NumRecordsWritten{};
+};
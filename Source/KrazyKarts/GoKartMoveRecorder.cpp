@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartMoveRecorder.h"
+
+#include "KrazyKarts.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarRecordMoves(
+		TEXT("kk.Net.RecordMoves"),
+		0,
+		TEXT("Record every kart move the server receives to Saved/MoveLogs for offline replay with GoKartBenchmark -Replay."));
+
+	TAutoConsoleVariable<float> CVarRecordKeyframeInterval(
+		TEXT("kk.Net.RecordKeyframeInterval"),
+		1.f,
+		TEXT("Seconds between server state keyframes per kart in move logs."));
+}
+
+bool UGoKartMoveRecorder::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && World->GetNetMode() != NM_Client;
+}
+
+void UGoKartMoveRecorder::Deinitialize()
+{
+	StopRecording();
+	Super::Deinitialize();
+}
+
+void UGoKartMoveRecorder::RecordMove(uint32 KartId, const FGoKartMove& Move)
+{
+	if (Writer)
+	{
+		FGoKartMoveLogRecord& Record = PendingRecords.AddDefaulted_GetRef();
+		Record.KartId = KartId;
+		Record.Move = Move;
+	}
+}
+
+void UGoKartMoveRecorder::RecordState(uint32 KartId, const FGoKartMove& LastMove, const FGoKartSimState& State, const FGoKartSimConstants& Constants)
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	const double CurrentTime = GetWorld()->GetTimeSeconds();
+	double& LastKeyframeTime = LastKeyframeTimes.FindOrAdd(KartId, -DBL_MAX);
+	if (CurrentTime - LastKeyframeTime < CVarRecordKeyframeInterval.GetValueOnGameThread())
+	{
+		return;
+	}
+	LastKeyframeTime = CurrentTime;
+
+	FGoKartMoveLogRecord& Record = PendingRecords.AddDefaulted_GetRef();
+	Record.Type = EGoKartMoveLogRecordType::Keyframe;
+	Record.KartId = KartId;
+	Record.Move = LastMove;
+	Record.State = State;
+	Record.Constants = Constants;
+}
+
+bool UGoKartMoveRecorder::IsTickable() const
+{
+	return !IsTemplate();
+}
+
+TStatId UGoKartMoveRecorder::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGoKartMoveRecorder, STATGROUP_Tickables);
+}
+
+void UGoKartMoveRecorder::Tick(float DeltaTime)
+{
+	const bool bWantsRecording = CVarRecordMoves.GetValueOnGameThread() != 0;
+	if (bWantsRecording && !Writer)
+	{
+		StartRecording();
+	}
+	else if (!bWantsRecording && Writer)
+	{
+		StopRecording();
+	}
+
+	if (Writer)
+	{
+		Writer->Enqueue(MoveTemp(PendingRecords));
+		PendingRecords.Reset();
+	}
+}
+
+void UGoKartMoveRecorder::StartRecording()
+{
+	const FString Filename = FPaths::ProjectSavedDir() / TEXT("MoveLogs") / FString::Printf(TEXT("%s_%s.kkmoves"),
+		*GetWorld()->GetMapName(), *FDateTime::Now().ToString());
+	Writer = MakeUnique<FGoKartMoveLogWriter>(Filename);
+	if (!Writer->IsOpen())
+	{
+		// Don't retry every frame
+		Writer.Reset();
+		CVarRecordMoves->Set(0, ECVF_SetByCode);
+		return;
+	}
+
+	// A new file needs a keyframe for every kart before its moves can be replayed
+	LastKeyframeTimes.Reset();
+	UE_LOG(LogKrazyKarts, Display, TEXT("Recording kart moves to %s"), *Writer->GetFilename());
+}
+
+void UGoKartMoveRecorder::StopRecording()
+{
+	if (Writer)
+	{
+		Writer->Enqueue(MoveTemp(PendingRecords));
+		PendingRecords.Reset();
+		Writer.Reset();
+	}
+}
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "GoKartMoveLog.h"
+#include "GoKartMoveRecorder.generated.h"
+
+/**
+ * Records every move the server receives, plus a state keyframe per kart every
+ * kk.Net.RecordKeyframeInterval seconds, to Saved/MoveLogs while kk.Net.RecordMoves is 1.
+ * Records are collected during the frame and handed to an FGoKartMoveLogWriter thread once
+ * per frame. Replay a log with GoKartBenchmark -Replay=<file>.
+ */
+UCLASS()
+class UGoKartMoveRecorder : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+	bool IsRecording() const { return Writer.IsValid(); }
+
+	void RecordMove(uint32 KartId, const FGoKartMove& Move);
+
+	// Keeps the state only when the kart's last keyframe is older than the keyframe interval
+	void RecordState(uint32 KartId, const FGoKartMove& LastMove, const FGoKartSimState& State, const FGoKartSimConstants& Constants);
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+private:
+	void StartRecording();
+	void StopRecording();
+
+	TUniquePtr<FGoKartMoveLogWriter> Writer;
+	TArray<FGoKartMoveLogRecord> PendingRecords;
+	TMap<uint32, double> LastKeyframeTimes;
+};
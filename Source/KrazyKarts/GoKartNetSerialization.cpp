@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartNetSerialization.h"
+
+#include "KrazyKarts.h"
+#include "GoKart.h"
+#include "Engine/NetSerialization.h"
+#include "HAL/IConsoleManager.h"
+#include "Serialization/BitWriter.h"
+#include "EngineUtils.h"
+
+namespace
+{
+	constexpr uint32 QuatComponentBits = 16;
+	constexpr uint32 MaxDeltaTimeMs = 1000;
+	constexpr double BandwidthReportPeriod = 5.0;
+
+	TAutoConsoleVariable<int32> CVarCompareBandwidth(
+		TEXT("kk.Net.CompareBandwidth"),
+		0,
+		TEXT("Log old vs quantized bytes per kart per second for kart moves and states."));
+
+	int64 MoveBits{};
+	int64 StateBits{};
+	int64 NumMoves{};
+	int64 NumStates{};
+	double LastReportTime{};
+
+	// Bits Serialize writes, counted in a scratch writer since the archive being saved to may be of any type
+	int64 CountBits(TFunctionRef<void(FArchive&)> Serialize)
+	{
+		FBitWriter Counter(0, true);
+		Serialize(Counter);
+		return Counter.GetNumBits();
+	}
+
+	void SerializeMove(FGoKartMove& Move, FArchive& Ar)
+	{
+		uint8 QuantizedThrottle = GoKartNet::QuantizeAxis(Move.Throttle);
+		uint8 QuantizedSteering = GoKartNet::QuantizeAxis(Move.Steering);
+		uint32 DeltaTimeMs = GoKartNet::QuantizeDeltaTime(Move.DeltaTime);
+		Ar << QuantizedThrottle;
+		Ar << QuantizedSteering;
+		Ar.SerializeIntPacked(DeltaTimeMs);
+		Ar << Move.TimeStamp;
+		Ar.SerializeIntPacked(Move.Sequence);
+
+		if (Ar.IsLoading())
+		{
+			Move.Throttle = GoKartNet::DequantizeAxis(QuantizedThrottle);
+			Move.Steering = GoKartNet::DequantizeAxis(QuantizedSteering);
+			Move.DeltaTime = GoKartNet::DequantizeDeltaTime(DeltaTimeMs);
+		}
+	}
+
+	bool SerializeState(FGoKartMoveState& State, FArchive& Ar)
+	{
+		FVector Location{ State.Transform.GetLocation() };
+		FQuat Rotation{ State.Transform.GetRotation() };
+		FVector Scale{ State.Transform.GetScale3D() };
+
+		// mm precision for location (cm), cm/s for velocity (m/s)
+		bool bSuccess = SerializePackedVector<10, 24>(Location, Ar);
+		bSuccess &= SerializePackedVector<100, 30>(State.Velocity, Ar);
+		GoKartNet::SerializeCompressedQuat(Rotation, Ar);
+
+		// Karts are almost never scaled, so only send the scale when it isn't one
+		uint8 bHasScale = !Scale.Equals(FVector::OneVector);
+		Ar.SerializeBits(&bHasScale, 1);
+		if (bHasScale)
+		{
+			Ar << Scale;
+		}
+		else
+		{
+			Scale = FVector::OneVector;
+		}
+
+		SerializeMove(State.LastMove, Ar);
+
+		if (Ar.IsLoading())
+		{
+			State.Transform = FTransform(Rotation, Location, Scale);
+		}
+		return bSuccess;
+	}
+}
+
+uint8 GoKartNet::QuantizeAxis(float Value)
+{
+	return uint8(FMath::RoundToInt(FMath::Clamp(Value, -1.f, 1.f) * 127.f) + 127);
+}
+
+float GoKartNet::DequantizeAxis(uint8 Value)
+{
+	return (int32(Value) - 127) / 127.f;
+}
+
+uint32 GoKartNet::QuantizeDeltaTime(float DeltaTime)
+{
+	return uint32(FMath::Clamp(FMath::RoundToInt(DeltaTime * 1000.f), 0, int32(MaxDeltaTimeMs)));
+}
+
+float GoKartNet::DequantizeDeltaTime(uint32 Milliseconds)
+{
+	return Milliseconds / 1000.f;
+}
+
+void GoKartNet::SerializeCompressedQuat(FQuat& Quat, FArchive& Ar)
+{
+	uint32 LargestIndex = 0;
+	if (Ar.IsSaving())
+	{
+		const FQuat Normalized{ Quat.GetNormalized() };
+		const float Components[4] = { Normalized.X, Normalized.Y, Normalized.Z, Normalized.W };
+		for (uint32 Index = 1; Index < 4; ++Index)
+		{
+			if (FMath::Abs(Components[Index]) > FMath::Abs(Components[LargestIndex]))
+			{
+				LargestIndex = Index;
+			}
+		}
+
+		// Q and -Q are the same rotation, so flip until the dropped component is positive
+		const float Sign = Components[LargestIndex] < 0.f ? -1.f : 1.f;
+		Ar.SerializeInt(LargestIndex, 4);
+		for (uint32 Index = 0; Index < 4; ++Index)
+		{
+			if (Index != LargestIndex)
+			{
+				WriteFixedCompressedFloat<1, QuatComponentBits>(Components[Index] * Sign, Ar);
+			}
+		}
+	}
+	else
+	{
+		float Components[4];
+		float SumSquares = 0.f;
+		Ar.SerializeInt(LargestIndex, 4);
+		for (uint32 Index = 0; Index < 4; ++Index)
+		{
+			if (Index != LargestIndex)
+			{
+				ReadFixedCompressedFloat<1, QuatComponentBits>(Components[Index], Ar);
+				SumSquares += Components[Index] * Components[Index];
+			}
+		}
+		Components[LargestIndex] = FMath::Sqrt(FMath::Max(0.f, 1.f - SumSquares));
+		Quat = FQuat(Components[0], Components[1], Components[2], Components[3]);
+	}
+}
+
+bool FGoKartBandwidthStats::IsEnabled()
+{
+	return CVarCompareBandwidth.GetValueOnAnyThread() != 0;
+}
+
+void FGoKartBandwidthStats::RecordMove(int64 NumBits)
+{
+	MoveBits += NumBits;
+	++NumMoves;
+}
+
+void FGoKartBandwidthStats::RecordState(int64 NumBits)
+{
+	StateBits += NumBits;
+	++NumStates;
+}
+
+void FGoKartBandwidthStats::ReportIfDue(const UWorld* World)
+{
+	const double CurrentTime = FPlatformTime::Seconds();
+	if (!IsEnabled() || CurrentTime - LastReportTime < BandwidthReportPeriod)
+	{
+		return;
+	}
+
+	int32 NumKarts = 0;
+	for (TActorIterator<AGoKart> It(World); It; ++It)
+	{
+		++NumKarts;
+	}
+
+	const double Elapsed = CurrentTime - LastReportTime;
+	const double Scale = 1.0 / (8.0 * Elapsed * FMath::Max(NumKarts, 1));
+	UE_LOG(LogKrazyKarts, Display, TEXT("Kart bandwidth (%d karts): moves %.1f -> %.1f B/s/kart, states %.1f -> %.1f B/s/kart"),
+		NumKarts,
+		NumMoves * LegacyMoveBits * Scale, MoveBits * Scale,
+		NumStates * LegacyStateBits * Scale, StateBits * Scale);
+
+	MoveBits = StateBits = NumMoves = NumStates = 0;
+	LastReportTime = CurrentTime;
+}
+
+void FGoKartMove::Quantize()
+{
+	Throttle = GoKartNet::DequantizeAxis(GoKartNet::QuantizeAxis(Throttle));
+	Steering = GoKartNet::DequantizeAxis(GoKartNet::QuantizeAxis(Steering));
+	DeltaTime = GoKartNet::DequantizeDeltaTime(GoKartNet::QuantizeDeltaTime(DeltaTime));
+}
+
+bool FGoKartMove::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	if (Ar.IsSaving() && FGoKartBandwidthStats::IsEnabled())
+	{
+		FGoKartMove Copy{ *this };
+		FGoKartBandwidthStats::RecordMove(CountBits([&Copy](FArchive& Counter) { SerializeMove(Copy, Counter); }));
+	}
+
+	SerializeMove(*this, Ar);
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+bool FGoKartMoveState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	if (Ar.IsSaving() && FGoKartBandwidthStats::IsEnabled())
+	{
+		FGoKartMoveState Copy{ *this };
+		FGoKartBandwidthStats::RecordState(CountBits([&Copy](FArchive& Counter) { SerializeState(Copy, Counter); }));
+	}
+
+	bOutSuccess = SerializeState(*this, Ar);
+	bOutSuccess &= !Ar.IsError();
+	return true;
+}
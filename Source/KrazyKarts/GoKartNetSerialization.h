@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+// Quantization helpers shared by the kart NetSerialize implementations.
+namespace GoKartNet
+{
+	// [-1,1] axis to 8 bits and back
+	uint8 QuantizeAxis(float Value);
+	float DequantizeAxis(uint8 Value);
+
+	// Seconds to whole milliseconds and back
+	uint32 QuantizeDeltaTime(float DeltaTime);
+	float DequantizeDeltaTime(uint32 Milliseconds);
+
+	// Smallest-three quaternion: 2 bit index of the dropped component and three 16 bit components
+	void SerializeCompressedQuat(FQuat& Quat, FArchive& Ar);
+}
+
+// Old vs new wire size of the kart structs, enabled with kk.Net.CompareBandwidth 1.
+struct FGoKartBandwidthStats
+{
+	// Uncompressed size of the old per-property replication: four floats and the sequence per move,
+	// a full FTransform, FVector velocity and move per state.
+	static constexpr int32 LegacyMoveBits = 5 * 32;
+	static constexpr int32 LegacyStateBits = 10 * 32 + 3 * 32 + LegacyMoveBits;
+
+	static bool IsEnabled();
+	static void RecordMove(int64 NumBits);
+	static void RecordState(int64 NumBits);
+
+	// Logs bytes per kart per second for the last period and resets the counters.
+	static void ReportIfDue(const UWorld* World);
+};
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartReplicationGraph.h"
+
+#include "GoKart.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+
+void UReplicationGraphNode_GoKarts::NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo)
+{
+	Karts.Add(CastChecked<AGoKart>(ActorInfo.Actor));
+}
+
+bool UReplicationGraphNode_GoKarts::NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound)
+{
+	return Karts.RemoveSingleSwap(Cast<AGoKart>(ActorInfo.Actor)) > 0;
+}
+
+void UReplicationGraphNode_GoKarts::NotifyResetAllNetworkActors()
+{
+	Karts.Reset();
+}
+
+void UReplicationGraphNode_GoKarts::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	const float NearDistanceSquared = FMath::Square(Graph->NearDistance);
+	const float MidDistanceSquared = FMath::Square(Graph->MidDistance);
+	const float FarDistanceSquared = FMath::Square(Graph->FarDistance);
+	const float ViewConeCos = FMath::Cos(FMath::DegreesToRadians(Graph->ViewConeHalfAngle));
+	const uint32 NearPeriod = Graph->GetReplicationPeriodFrames(Graph->NearUpdateRate);
+	const uint32 MidPeriod = Graph->GetReplicationPeriodFrames(Graph->MidUpdateRate);
+	const uint32 FarPeriod = Graph->GetReplicationPeriodFrames(Graph->FarUpdateRate);
+
+	GatheredKarts.Reset();
+	for (AGoKart* Kart : Karts)
+	{
+		uint32 Period = 0;
+		if (Kart->GetNetConnection() == Params.ConnectionManager.NetConnection)
+		{
+			// Our own kart carries the move acks, so it never gets throttled
+			Period = NearPeriod;
+		}
+		else
+		{
+			const FVector KartLocation{ Kart->GetActorLocation() };
+			for (const FNetViewer& Viewer : Params.Viewers)
+			{
+				const FVector ToKart{ KartLocation - Viewer.ViewLocation };
+				const float DistanceSquared = ToKart.SizeSquared();
+				uint32 ViewerPeriod = 0;
+				if (DistanceSquared <= NearDistanceSquared)
+				{
+					ViewerPeriod = NearPeriod;
+				}
+				else if (DistanceSquared <= MidDistanceSquared)
+				{
+					const bool bInView = FVector::DotProduct(ToKart, Viewer.ViewDir) >= ViewConeCos * FMath::Sqrt(DistanceSquared);
+					ViewerPeriod = bInView ? NearPeriod : MidPeriod;
+				}
+				else if (DistanceSquared <= FarDistanceSquared)
+				{
+					ViewerPeriod = FarPeriod;
+				}
+
+				// Splitscreen connections take the fastest rate any of their viewers needs
+				if (ViewerPeriod != 0 && (Period == 0 || ViewerPeriod < Period))
+				{
+					Period = ViewerPeriod;
+				}
+			}
+		}
+
+		if (Period != 0)
+		{
+			Params.ConnectionManager.ActorInfoMap.FindOrAdd(Kart).ReplicationPeriodFrame = Period;
+			GatheredKarts.Add(Kart);
+		}
+	}
+
+	Params.OutGatheredReplicationLists.AddReplicationActorList(GatheredKarts);
+}
+
+UGoKartReplicationGraph::UGoKartReplicationGraph()
+{
+	NearDistance = 5000.f;
+	MidDistance = 20000.f;
+	FarDistance = 50000.f;
+	ViewConeHalfAngle = 60.f;
+	NearUpdateRate = 30.f;
+	MidUpdateRate = 10.f;
+	FarUpdateRate = 2.f;
+}
+
+void UGoKartReplicationGraph::InitGlobalGraphNodes()
+{
+	Super::InitGlobalGraphNodes();
+
+	KartNode = CreateNewNode<UReplicationGraphNode_GoKarts>();
+	KartNode->Graph = this;
+	AddGlobalGraphNode(KartNode);
+}
+
+void UGoKartReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	if (ActorInfo.Actor->IsA<AGoKart>())
+	{
+		KartNode->NotifyAddNetworkActor(ActorInfo);
+	}
+	else
+	{
+		Super::RouteAddNetworkActorToNodes(ActorInfo, GlobalInfo);
+	}
+}
+
+void UGoKartReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	if (ActorInfo.Actor->IsA<AGoKart>())
+	{
+		KartNode->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	else
+	{
+		Super::RouteRemoveNetworkActorToNodes(ActorInfo);
+	}
+}
+
+uint32 UGoKartReplicationGraph::GetReplicationPeriodFrames(float UpdateRate) const
+{
+	const float ServerTickRate = NetDriver ? float(NetDriver->NetServerMaxTickRate) : 30.f;
+	return uint32(FMath::Max(FMath::RoundToInt(ServerTickRate / FMath::Max(UpdateRate, 0.01f)), 1));
+}
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BasicReplicationGraph.h"
+#include "GoKartReplicationGraph.generated.h"
+
+class AGoKart;
+class UGoKartReplicationGraph;
+
+/**
+ * Gathers karts for each connection at a rate chosen per viewer: full rate when near or in view,
+ * throttled with distance, and culled past FarDistance. The connection's own kart always goes at full rate.
+ */
+UCLASS()
+class UReplicationGraphNode_GoKarts : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override;
+	virtual void NotifyResetAllNetworkActors() override;
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+
+	UPROPERTY()
+	UGoKartReplicationGraph* Graph;
+
+private:
+	UPROPERTY()
+	TArray<AGoKart*> Karts;
+
+	// Rebuilt for every connection; each connection is replicated right after it is gathered
+	FActorRepListRefView GatheredKarts;
+};
+
+/**
+ * Replication graph for large kart lobbies. Everything except karts is handled by the basic
+ * spatial grid; karts go through UReplicationGraphNode_GoKarts. The engine's per-connection
+ * bandwidth limit still applies on top and starves the lowest priority (most distant) karts first.
+ */
+UCLASS(transient, config=Engine)
+class UGoKartReplicationGraph : public UBasicReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	UGoKartReplicationGraph();
+
+	virtual void InitGlobalGraphNodes() override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+
+	// Frames between updates of a kart to one connection for the given rate in Hz
+	uint32 GetReplicationPeriodFrames(float UpdateRate) const;
+
+	UPROPERTY(config)
+	float NearDistance; // cm, full rate regardless of view direction
+
+	UPROPERTY(config)
+	float MidDistance; // cm, full rate inside the view cone, MidUpdateRate outside it
+
+	UPROPERTY(config)
+	float FarDistance; // cm, FarUpdateRate up to here, culled beyond
+
+	UPROPERTY(config)
+	float ViewConeHalfAngle; // degrees
+
+	UPROPERTY(config)
+	float NearUpdateRate; // Hz
+
+	UPROPERTY(config)
+	float MidUpdateRate; // Hz
+
+	UPROPERTY(config)
+	float FarUpdateRate; // Hz
+
+private:
+	UPROPERTY()
+	UReplicationGraphNode_GoKarts* KartNode;
+};
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Fixed-capacity FIFO that allocates once in Init. Pushing into a full buffer drops the
+ * oldest element, so the newest data is always kept. Index 0 is the oldest element.
+ */
+template<typename ElementType>
+class TGoKartRingBuffer
+{
+public:
+	// Capacity is rounded up to a power of two.
+	void Init(int32 InCapacity)
+	{
+		Elements.SetNum(FMath::RoundUpToPowerOfTwo(FMath::Max(InCapacity, 1)));
+		IndexMask = Elements.Num() - 1;
+		Head = 0;
+		Count = 0;
+	}
+
+	// Returns false when the buffer was full and the oldest element was dropped to make room.
+	bool Push(const ElementType& Element)
+	{
+		checkSlow(Elements.Num() > 0);
+		const bool bHadRoom = Count < Elements.Num();
+		if (!bHadRoom)
+		{
+			PopFront(1);
+		}
+		Elements[(Head + Count) & IndexMask] = Element;
+		++Count;
+		return bHadRoom;
+	}
+
+	void PopFront(int32 NumToPop)
+	{
+		NumToPop = FMath::Clamp(NumToPop, 0, Count);
+		Head = (Head + NumToPop) & IndexMask;
+		Count -= NumToPop;
+	}
+
+	void Reset()
+	{
+		Head = 0;
+		Count = 0;
+	}
+
+	int32 Num() const { return Count; }
+	int32 Capacity() const { return Elements.Num(); }
+	bool IsEmpty() const { return Count == 0; }
+
+	ElementType& operator[](int32 Index)
+	{
+		checkSlow(Index >= 0 && Index < Count);
+		return Elements[(Head + Index) & IndexMask];
+	}
+
+	const ElementType& operator[](int32 Index) const
+	{
+		checkSlow(Index >= 0 && Index < Count);
+		return Elements[(Head + Index) & IndexMask];
+	}
+
+	ElementType& Last(int32 IndexFromTheEnd = 0)
+	{
+		return (*this)[Count - 1 - IndexFromTheEnd];
+	}
+
+	const ElementType& Last(int32 IndexFromTheEnd = 0) const
+	{
+		return (*this)[Count - 1 - IndexFromTheEnd];
+	}
+
+private:
+	TArray<ElementType> Elements;
+	int32 IndexMask{};
+	int32 Head{};
+	int32 Count{};
+};
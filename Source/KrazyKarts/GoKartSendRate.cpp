@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartSendRate.h"
+
+namespace
+{
+	// Seconds between rate changes, long enough for the last change to show in the measurements
+	constexpr float AdjustPeriod = 0.5f;
+
+	// Multiplier while congested and Hz added while clear
+	constexpr float DecreaseFactor = 0.75f;
+	constexpr float IncreaseStep = 5.f;
+
+	// Congested above the first of each, clear below the second
+	constexpr float HighRoundTripTime = 0.15f;
+	constexpr float LowRoundTripTime = 0.08f;
+	constexpr float HighQueueDelay = 0.08f;
+	constexpr float LowQueueDelay = 0.04f;
+	constexpr float HighSaturation = 0.05f;
+	constexpr float LowSaturation = 0.01f;
+
+	// Seconds the measurements are smoothed over
+	constexpr float SmoothingTime = 0.5f;
+
+	// s/s the base ack latency creeps up, so a route that got slower becomes the new base instead of congestion
+	constexpr float BaseAckLatencyDrift = 0.01f;
+
+	float Smooth(float Current, float Sample, float DeltaTime)
+	{
+		return FMath::Lerp(Current, Sample, FMath::Clamp(DeltaTime / SmoothingTime, 0.f, 1.f));
+	}
+}
+
+void FGoKartSendRateController::Init(float InMinRate, float InMaxRate, int32 InBaseRedundancy)
+{
+	MaxRate = FMath::Max(InMaxRate, 1.f);
+	MinRate = FMath::Clamp(InMinRate, 1.f, MaxRate);
+	BaseRedundancy = FMath::Max(InBaseRedundancy, 1);
+	SendRate = MaxRate;
+}
+
+void FGoKartSendRateController::Update(float DeltaTime, float InRoundTripTime, bool bQueueSaturated)
+{
+	RoundTripTime = Smooth(RoundTripTime, InRoundTripTime, DeltaTime);
+	Saturation = Smooth(Saturation, bQueueSaturated ? 1.f : 0.f, DeltaTime);
+	BaseAckLatency += BaseAckLatencyDrift * DeltaTime;
+
+	TimeSinceAdjust += DeltaTime;
+	if (TimeSinceAdjust < AdjustPeriod)
+	{
+		return;
+	}
+	TimeSinceAdjust = 0.f;
+
+	if (IsCongested())
+	{
+		SendRate = FMath::Max(SendRate * DecreaseFactor, MinRate);
+	}
+	else if (IsClear())
+	{
+		SendRate = FMath::Min(SendRate + IncreaseStep, MaxRate);
+	}
+}
+
+void FGoKartSendRateController::AddAckLatency(float InAckLatency)
+{
+	AckLatency = AckLatency > 0.f ? FMath::Lerp(AckLatency, InAckLatency, 0.1f) : InAckLatency;
+	BaseAckLatency = FMath::Min(BaseAckLatency, InAckLatency);
+}
+
+int32 FGoKartSendRateController::GetRedundancy() const
+{
+	return FMath::CeilToInt(BaseRedundancy * MaxRate / FMath::Max(SendRate, 1.f));
+}
+
+bool FGoKartSendRateController::IsCongested() const
+{
+	return Saturation > HighSaturation || RoundTripTime > HighRoundTripTime || GetQueueDelay() > HighQueueDelay;
+}
+
+bool FGoKartSendRateController::IsClear() const
+{
+	return Saturation < LowSaturation && RoundTripTime < LowRoundTripTime && GetQueueDelay() < LowQueueDelay;
+}
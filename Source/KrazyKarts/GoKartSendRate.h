@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Picks how often an autonomous proxy sends its moves and how many recent moves each send
+ * repeats, from how its connection behaves: round trip time, how long the server takes to
+ * acknowledge a move and how often the outgoing queue is full. Ack latency above the lowest
+ * seen recently is queueing somewhere on the way, or the server's replication interval.
+ * Every adjustment period the rate drops by a quarter while the link looks congested and
+ * climbs back a few Hz while it looks clear. Redundancy grows as the rate drops, so every
+ * send still covers the same span of play.
+ */
+class KRAZYKARTS_API FGoKartSendRateController
+{
+public:
+	// Starts at MaxRate, which is also what a connection that never reports anything keeps
+	void Init(float InMinRate, float InMaxRate, int32 InBaseRedundancy);
+
+	// Once per frame, with the connection's round trip time and whether it could not take more data
+	void Update(float DeltaTime, float RoundTripTime, bool bQueueSaturated);
+
+	// A server state acknowledged a move first sent AckLatency seconds ago
+	void AddAckLatency(float AckLatency);
+
+	float GetSendRate() const { return SendRate; }
+	int32 GetRedundancy() const;
+
+	// Smoothed measurements, in seconds and as the fraction of frames the queue was full
+	float GetRoundTripTime() const { return RoundTripTime; }
+	float GetAckLatency() const { return AckLatency; }
+	float GetQueueDelay() const { return FMath::Max(AckLatency - BaseAckLatency, 0.f); }
+	float GetSaturation() const { return Saturation; }
+
+private:
+	bool IsCongested() const;
+	bool IsClear() const;
+
+	float MinRate{};
+	float MaxRate{};
+	int32 BaseRedundancy{};
+
+	float SendRate{};
+	float TimeSinceAdjust{};
+
+	float RoundTripTime{};
+	float AckLatency{};
+	float BaseAckLatency{ MAX_flt };
+	float Saturation{};
+};
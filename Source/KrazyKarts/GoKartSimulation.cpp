@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartSimulation.h"
+
+FVector GoKartSimulation::GetAirResistance(const FVector& Velocity, const FGoKartSimParams& Params)
+{
+	return -Velocity.GetSafeNormal() * Velocity.SizeSquared() * Params.DragCoefficient;
+}
+
+FVector GoKartSimulation::GetRollingResistance(const FVector& Velocity, const FGoKartSimParams& Params)
+{
+	float AccelerationDueToGravity = -Params.GravityZ / 100.f;
+	float NormalForceAcceleration = Params.Mass * AccelerationDueToGravity;
+	return -Velocity.GetSafeNormal() * Params.RollingResistanceCoefficient * NormalForceAcceleration;
+}
+
+FVector GoKartSimulation::IntegrateVelocity(const FGoKartSimState& State, const FGoKartMove& Move, const FGoKartSimParams& Params)
+{
+	FVector Force = State.Rotation.GetForwardVector() * Params.MaxDrivingForce * Move.Throttle;
+	Force += GetAirResistance(State.Velocity, Params);
+	Force += GetRollingResistance(State.Velocity, Params);
+
+	FVector Acceleration = Force / Params.Mass;
+	return State.Velocity + Acceleration * Move.DeltaTime;
+}
+
+FQuat GoKartSimulation::GetRotationDelta(const FQuat& Rotation, FVector& InOutVelocity, float DeltaTime, float Steering, const FGoKartSimParams& Params)
+{
+	float DeltaLocation = FVector::DotProduct(Rotation.GetForwardVector(), InOutVelocity) * DeltaTime;
+	float RotationAngle = DeltaLocation / Params.MinTurningRadius * Steering;
+	FQuat RotationDelta(Rotation.GetUpVector(), RotationAngle);
+	InOutVelocity = RotationDelta.RotateVector(InOutVelocity);
+	return RotationDelta;
+}
+
+FVector GoKartSimulation::GetLocationDelta(const FVector& Velocity, float DeltaTime)
+{
+	return Velocity * DeltaTime * 100.f;
+}
+
+FGoKartSimState GoKartSimulation::Step(const FGoKartSimState& State, const FGoKartMove& Move, const FGoKartSimParams& Params)
+{
+	FGoKartSimState Result;
+	Result.Velocity = IntegrateVelocity(State, Move, Params);
+
+	FQuat RotationDelta{ GetRotationDelta(State.Rotation, Result.Velocity, Move.DeltaTime, Move.Steering, Params) };
+	Result.Rotation = State.Rotation * RotationDelta;
+	Result.Location = State.Location + GetLocationDelta(Result.Velocity, Move.DeltaTime);
+	return Result;
+}
+
+FGoKartSimConstants FGoKartSimConstants::Make(const FGoKartSimParams& Params)
+{
+	float AccelerationDueToGravity = -Params.GravityZ / 100.f;
+
+	FGoKartSimConstants Constants;
+	Constants.InvMass = 1.f / Params.Mass;
+	Constants.MaxDrivingForce = Params.MaxDrivingForce;
+	Constants.DragCoefficient = Params.DragCoefficient;
+	Constants.RollingResistanceCoefficient = Params.RollingResistanceCoefficient;
+	Constants.NormalForceAcceleration = Params.Mass * AccelerationDueToGravity;
+	Constants.MinTurningRadius = Params.MinTurningRadius;
+	return Constants;
+}
+
+void GoKartSimulation::IntegrateMove(const FGoKartSimConstants& Constants, const FVector& Forward, const FVector& Up, const FGoKartMove& Move,
+	FVector& InOutVelocity, FQuat& OutRotationDelta, FVector& OutLocationDelta)
+{
+	FVector V{ InOutVelocity };
+
+	// FVector::GetSafeNormal, computed once for both resistances. A unit velocity is its own normal and
+	// one too slow to normalise gives +0, as the engine returns it.
+	const float SpeedSquared = V.X * V.X + V.Y * V.Y + V.Z * V.Z;
+	FVector Direction{ FVector::ZeroVector };
+	if (SpeedSquared == 1.f)
+	{
+		Direction = V;
+	}
+	else if (SpeedSquared >= SMALL_NUMBER)
+	{
+		const float Scale = FMath::InvSqrt(SpeedSquared);
+		Direction = FVector(V.X * Scale, V.Y * Scale, V.Z * Scale);
+	}
+
+	// Driving force plus air resistance (speed squared) plus rolling resistance, summed in that order
+	const float ForceX = (Forward.X * Constants.MaxDrivingForce) * Move.Throttle + ((-Direction.X) * SpeedSquared) * Constants.DragCoefficient + ((-Direction.X) * Constants.RollingResistanceCoefficient) * Constants.NormalForceAcceleration;
+	const float ForceY = (Forward.Y * Constants.MaxDrivingForce) * Move.Throttle + ((-Direction.Y) * SpeedSquared) * Constants.DragCoefficient + ((-Direction.Y) * Constants.RollingResistanceCoefficient) * Constants.NormalForceAcceleration;
+	const float ForceZ = (Forward.Z * Constants.MaxDrivingForce) * Move.Throttle + ((-Direction.Z) * SpeedSquared) * Constants.DragCoefficient + ((-Direction.Z) * Constants.RollingResistanceCoefficient) * Constants.NormalForceAcceleration;
+	V.X = V.X + (ForceX * Constants.InvMass) * Move.DeltaTime;
+	V.Y = V.Y + (ForceY * Constants.InvMass) * Move.DeltaTime;
+	V.Z = V.Z + (ForceZ * Constants.InvMass) * Move.DeltaTime;
+
+	// Turn by the arc driven forward this move, same as FQuat(Up, Angle)
+	const float DeltaLocation = (Forward.X * V.X + Forward.Y * V.Y + Forward.Z * V.Z) * Move.DeltaTime;
+	const float RotationAngle = DeltaLocation / Constants.MinTurningRadius * Move.Steering;
+	float Sin, Cos;
+	FMath::SinCos(&Sin, &Cos, 0.5f * RotationAngle);
+	const float QX = Sin * Up.X;
+	const float QY = Sin * Up.Y;
+	const float QZ = Sin * Up.Z;
+	const float QW = Cos;
+
+	// Velocity follows the kart round, same as FQuat::RotateVector: V + W * T + Q x T with T = 2 (Q x V)
+	const float TX = 2.f * (QY * V.Z - QZ * V.Y);
+	const float TY = 2.f * (QZ * V.X - QX * V.Z);
+	const float TZ = 2.f * (QX * V.Y - QY * V.X);
+	InOutVelocity.X = V.X + QW * TX + (QY * TZ - QZ * TY);
+	InOutVelocity.Y = V.Y + QW * TY + (QZ * TX - QX * TZ);
+	InOutVelocity.Z = V.Z + QW * TZ + (QX * TY - QY * TX);
+
+	OutRotationDelta = FQuat(QX, QY, QZ, QW);
+	OutLocationDelta.X = (InOutVelocity.X * Move.DeltaTime) * 100.f;
+	OutLocationDelta.Y = (InOutVelocity.Y * Move.DeltaTime) * 100.f;
+	OutLocationDelta.Z = (InOutVelocity.Z * Move.DeltaTime) * 100.f;
+}
+
+FGoKartSimState GoKartSimulation::Step(const FGoKartSimState& State, const FGoKartMove& Move, const FGoKartSimConstants& Constants)
+{
+	FGoKartSimState Result;
+	Result.Velocity = State.Velocity;
+
+	FQuat RotationDelta;
+	FVector LocationDelta;
+	IntegrateMove(Constants, State.Rotation.GetForwardVector(), State.Rotation.GetUpVector(), Move, Result.Velocity, RotationDelta, LocationDelta);
+
+	Result.Rotation = State.Rotation * RotationDelta;
+	Result.Location = State.Location + LocationDelta;
+	return Result;
+}
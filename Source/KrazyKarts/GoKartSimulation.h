@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartSimulation.generated.h"
+
+
+USTRUCT()
+struct FGoKartMove
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	float Throttle;
+
+	UPROPERTY()
+	float Steering;
+
+	UPROPERTY()
+	float DeltaTime;
+
+	UPROPERTY()
+	float TimeStamp;
+
+	// Increases by one for every move a kart creates, starting at 1
+	UPROPERTY()
+	uint32 Sequence;
+
+	// Rounds the move to exactly what NetSerialize puts on the wire, so client and server simulate the same input.
+	void Quantize();
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FGoKartMove> : public TStructOpsTypeTraitsBase2<FGoKartMove>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+// Tuning values of a kart, copied out of AGoKart so the integrator never touches the actor.
+struct FGoKartSimParams
+{
+	float Mass = 1000.f; // kg
+	float MaxDrivingForce = 10000.f; // Newtons
+	float MinTurningRadius = 10.f; // m
+	float DragCoefficient = 16.f; // kg/m
+	float RollingResistanceCoefficient = 0.015f;
+	float GravityZ = -980.f; // cm/s/s, as returned by UWorld::GetGravityZ()
+};
+
+// Per-kart values derived once from FGoKartSimParams, so a move needs no world queries or divides.
+// Each is computed exactly as the reference functions compute it, which keeps IntegrateMove bit-identical to them.
+struct FGoKartSimConstants
+{
+	float InvMass = 0.f; // the reciprocal FVector's divide by a scalar multiplies by
+	float MaxDrivingForce = 0.f;
+	float DragCoefficient = 0.f;
+	float RollingResistanceCoefficient = 0.f;
+	float NormalForceAcceleration = 0.f; // mass times acceleration due to gravity
+	float MinTurningRadius = 0.f;
+
+	static KRAZYKARTS_API FGoKartSimConstants Make(const FGoKartSimParams& Params);
+};
+
+// Everything the integrator reads and writes for one kart.
+struct FGoKartSimState
+{
+	FVector Location{ FVector::ZeroVector }; // cm
+	FQuat Rotation{ FQuat::Identity };
+	FVector Velocity{ FVector::ZeroVector }; // m/s
+};
+
+// Deterministic kart physics with no world or actor access. AGoKart runs the same
+// functions and only adds the collision sweeps on top.
+namespace GoKartSimulation
+{
+	// Reference model, kept as written so the optimised paths below have something to be checked against.
+
+	KRAZYKARTS_API FVector GetAirResistance(const FVector& Velocity, const FGoKartSimParams& Params);
+	KRAZYKARTS_API FVector GetRollingResistance(const FVector& Velocity, const FGoKartSimParams& Params);
+
+	// Velocity after the driving force and both resistances have been applied for one move.
+	KRAZYKARTS_API FVector IntegrateVelocity(const FGoKartSimState& State, const FGoKartMove& Move, const FGoKartSimParams& Params);
+
+	// Turn taken during the move, to be applied as a local rotation. Rotates InOutVelocity along with the kart.
+	KRAZYKARTS_API FQuat GetRotationDelta(const FQuat& Rotation, FVector& InOutVelocity, float DeltaTime, float Steering, const FGoKartSimParams& Params);
+
+	// World offset in cm covered during the move.
+	KRAZYKARTS_API FVector GetLocationDelta(const FVector& Velocity, float DeltaTime);
+
+	// Advances State by one move, ignoring collision.
+	KRAZYKARTS_API FGoKartSimState Step(const FGoKartSimState& State, const FGoKartMove& Move, const FGoKartSimParams& Params);
+
+	// One move of the reference model from cached constants. Updates InOutVelocity and returns the turn as a
+	// rotation to apply locally and the distance covered as a world offset in cm.
+	// Performs the same float operations in the same order as IntegrateVelocity and GetRotationDelta, and
+	// GoKartKernel's SIMD path does the same again lane by lane, so keep all three in step.
+	KRAZYKARTS_API void IntegrateMove(const FGoKartSimConstants& Constants, const FVector& Forward, const FVector& Up, const FGoKartMove& Move,
+		FVector& InOutVelocity, FQuat& OutRotationDelta, FVector& OutLocationDelta);
+
+	// Step from cached constants, through IntegrateMove.
+	KRAZYKARTS_API FGoKartSimState Step(const FGoKartSimState& State, const FGoKartMove& Move, const FGoKartSimConstants& Constants);
+}
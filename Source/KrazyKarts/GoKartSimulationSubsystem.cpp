@@ -0,0 +1,246 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartSimulationSubsystem.h"
+
+#include "GoKart.h"
+#include "KrazyKarts.h"
+#include "KrazyKartsServerStats.h"
+#include "Algo/StableSort.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarBatchedSimulation(
+		TEXT("kk.Sim.Batched"),
+		1,
+		TEXT("Simulate server karts in one batched pass per frame instead of per RPC and per actor."));
+
+	TAutoConsoleVariable<int32> CVarParallelThreshold(
+		TEXT("kk.Sim.ParallelThreshold"),
+		64,
+		TEXT("Minimum number of karts with moves in a frame before the batch is split across worker threads, 0 never splits."));
+
+	TAutoConsoleVariable<int32> CVarSimd(
+		TEXT("kk.Sim.Simd"),
+		1,
+		TEXT("Integrate batched karts with the SIMD kernel where supported, 0 uses the scalar kernel. Results are identical."));
+
+	TAutoConsoleVariable<float> CVarMoveBudget(
+		TEXT("kk.Server.MoveBudgetMs"),
+		2.f,
+		TEXT("Game thread ms per frame for simulating queued client moves, shared equally by the karts with moves. Every kart still gets one move a frame. 0 drains every queue."));
+
+	// Karts per kernel batch handed to one worker
+	constexpr int32 KartsPerChunk = 256;
+
+	// Weight of the newest frame in the cost per move
+	constexpr float MoveCostSmoothing = 0.1f;
+}
+
+DECLARE_CYCLE_STAT(TEXT("Drain Move Queues"), STAT_GoKartDrainMoveQueues, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued Server Moves"), STAT_GoKartQueuedServerMoves, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("Batched Simulation Gather"), STAT_GoKartBatchGather, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("Batched Simulation Integrate"), STAT_GoKartBatchIntegrate, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("Batched Simulation WriteBack"), STAT_GoKartBatchWriteBack, STATGROUP_KrazyKarts);
+
+bool UGoKartSimulationSubsystem::IsBatchingEnabled()
+{
+	return CVarBatchedSimulation.GetValueOnGameThread() != 0;
+}
+
+bool UGoKartSimulationSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && World->GetNetMode() != NM_Client;
+}
+
+void UGoKartSimulationSubsystem::Register(AGoKart* Kart)
+{
+	Karts.AddUnique(Kart);
+}
+
+void UGoKartSimulationSubsystem::Unregister(AGoKart* Kart)
+{
+	Karts.RemoveSingleSwap(Kart);
+}
+
+bool UGoKartSimulationSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Karts.Num() > 0;
+}
+
+TStatId UGoKartSimulationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGoKartSimulationSubsystem, STATGROUP_Tickables);
+}
+
+void UGoKartSimulationSubsystem::Tick(float DeltaTime)
+{
+	DrainMoveQueues();
+
+	Gather();
+	if (BatchKarts.Num() == 0)
+	{
+		return;
+	}
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	Integrate();
+	WriteBack();
+	AddMoveCost(FPlatformTime::Cycles64() - StartCycles, Moves.Num());
+
+	if (UKrazyKartsServerStats* ServerStats = GetWorld()->GetSubsystem<UKrazyKartsServerStats>())
+	{
+		ServerStats->AddSimulateCost(FPlatformTime::Cycles64() - StartCycles, Moves.Num());
+	}
+}
+
+void UGoKartSimulationSubsystem::DrainMoveQueues()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartDrainMoveQueues);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, DrainMoveQueues);
+
+	int32 NumQueuedKarts = 0;
+	int32 NumQueuedMoves = 0;
+	for (const AGoKart* Kart : Karts)
+	{
+		NumQueuedKarts += Kart->GetNumQueuedServerMoves() > 0;
+		NumQueuedMoves += Kart->GetNumQueuedServerMoves();
+	}
+	SET_DWORD_STAT(STAT_GoKartQueuedServerMoves, NumQueuedMoves);
+	if (NumQueuedKarts == 0)
+	{
+		return;
+	}
+
+	const float BudgetMs = CVarMoveBudget.GetValueOnGameThread();
+	const int32 MaxMovesPerKart = BudgetMs > 0.f && MoveCostMs > 0.f
+		? FMath::Max(FMath::FloorToInt(BudgetMs / NumQueuedKarts / MoveCostMs), 1)
+		: MAX_int32;
+
+	// Without batching the moves are simulated right here, so this is where they cost
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	int32 NumDrained = 0;
+	for (AGoKart* Kart : Karts)
+	{
+		NumDrained += Kart->DrainServerMoves(MaxMovesPerKart);
+	}
+	if (!IsBatchingEnabled())
+	{
+		AddMoveCost(FPlatformTime::Cycles64() - StartCycles, NumDrained);
+	}
+}
+
+void UGoKartSimulationSubsystem::AddMoveCost(uint64 Cycles, int32 NumMoves)
+{
+	if (NumMoves > 0)
+	{
+		const float CostMs = float(FPlatformTime::ToMilliseconds64(Cycles) / NumMoves);
+		MoveCostMs = MoveCostMs > 0.f ? FMath::Lerp(MoveCostMs, CostMs, MoveCostSmoothing) : CostMs;
+	}
+}
+
+void UGoKartSimulationSubsystem::Gather()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartBatchGather);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, BatchGather);
+
+	BatchKarts.Reset();
+	Constants.Reset();
+	StartLocations.Reset();
+	Locations.Reset();
+	Rotations.Reset();
+	Velocities.Reset();
+	FirstMoves.Reset();
+	NumMoves.Reset();
+	Moves.Reset();
+
+	for (AGoKart* Kart : Karts)
+	{
+		if (Kart->GetNumPendingServerMoves() > 0)
+		{
+			BatchKarts.Add(Kart);
+		}
+	}
+
+	// Karts still integrating in a round are then always the first ones
+	Algo::StableSort(BatchKarts, [](const AGoKart* A, const AGoKart* B)
+	{
+		return A->GetNumPendingServerMoves() > B->GetNumPendingServerMoves();
+	});
+
+	for (AGoKart* Kart : BatchKarts)
+	{
+		const FGoKartSimState State{ Kart->GetSimState() };
+		Constants.Add(Kart->GetSimConstants());
+		StartLocations.Add(State.Location);
+		Locations.Add(State.Location);
+		Rotations.Add(State.Rotation);
+		Velocities.Add(State.Velocity);
+		FirstMoves.Add(Moves.Num());
+		NumMoves.Add(Kart->GetNumPendingServerMoves());
+		Kart->TakePendingServerMoves(Moves);
+	}
+}
+
+void UGoKartSimulationSubsystem::Integrate()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartBatchIntegrate);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, BatchIntegrate);
+
+	const int32 ParallelThreshold = CVarParallelThreshold.GetValueOnGameThread();
+	const bool bAllowSimd = CVarSimd.GetValueOnGameThread() != 0;
+
+	// One move per kart per round; karts run out of moves from the back of the sorted arrays
+	int32 NumActive = BatchKarts.Num();
+	for (int32 Round = 0; Round < NumMoves[0]; ++Round)
+	{
+		while (NumMoves[NumActive - 1] <= Round)
+		{
+			--NumActive;
+		}
+
+		const int32 NumChunks = FMath::DivideAndRoundUp(NumActive, KartsPerChunk);
+		if (Chunks.Num() < NumChunks)
+		{
+			Chunks.SetNum(NumChunks);
+		}
+
+		// Each kart only touches its own slots, so the chunks can run on any thread in any order
+		const bool bSingleThreaded = ParallelThreshold <= 0 || NumActive < ParallelThreshold;
+		ParallelFor(NumChunks, [this, Round, NumActive, bAllowSimd](int32 Chunk)
+		{
+			const int32 Begin = Chunk * KartsPerChunk;
+			const int32 End = FMath::Min(Begin + KartsPerChunk, NumActive);
+			FGoKartKernelBatch& Batch = Chunks[Chunk];
+			Batch.SetNum(End - Begin);
+			for (int32 Index = Begin; Index < End; ++Index)
+			{
+				Batch.SetLane(Index - Begin, Constants[Index], Rotations[Index], Velocities[Index], Moves[FirstMoves[Index] + Round]);
+			}
+
+			GoKartKernel::Integrate(Batch, bAllowSimd);
+
+			// Same composition as GoKartSimulation::Step
+			for (int32 Index = Begin; Index < End; ++Index)
+			{
+				Velocities[Index] = Batch.GetVelocity(Index - Begin);
+				Rotations[Index] = Rotations[Index] * Batch.GetRotationDelta(Index - Begin);
+				Locations[Index] = Locations[Index] + Batch.GetLocationDelta(Index - Begin);
+			}
+		}, bSingleThreaded);
+	}
+}
+
+void UGoKartSimulationSubsystem::WriteBack()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GoKartBatchWriteBack);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, BatchWriteBack);
+
+	for (int32 Index = 0; Index < BatchKarts.Num(); ++Index)
+	{
+		const TArrayView<const FGoKartMove> KartMoves{ MakeArrayView(&Moves[FirstMoves[Index]], NumMoves[Index]) };
+		BatchKarts[Index]->ApplyBatchedMoves(KartMoves, Rotations[Index], Locations[Index] - StartLocations[Index], Velocities[Index]);
+	}
+}
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "GoKartSimulation.h"
+#include "GoKartKernel.h"
+#include "GoKartSimulationSubsystem.generated.h"
+
+class AGoKart;
+
+/**
+ * Runs the authoritative simulation of every server kart in one pass per frame instead of
+ * inside each RPC and actor Tick. Moves queued by the karts are integrated from a
+ * structure-of-arrays copy of their state, split across workers with ParallelFor once there
+ * are enough karts, and the results are written back to the actors in a single sweep per kart.
+ * A kart whose combined path is blocked is re-simulated one sweep per move instead, as its
+ * owning client predicted it. Karts are sorted by move count so every round of GoKartKernel
+ * covers a contiguous prefix.
+ * Toggled with kk.Sim.Batched.
+ *
+ * Moves from clients wait in each kart's queue until this tick. Every kart with queued moves
+ * gets an equal share of kk.Server.MoveBudgetMs and drains as many moves as that share pays
+ * for at the measured cost per move, at least one, so a burst of packets or a flooding client
+ * is spread over the next frames instead of landing on one.
+ */
+UCLASS()
+class UGoKartSimulationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static bool IsBatchingEnabled();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	void Register(AGoKart* Kart);
+	void Unregister(AGoKart* Kart);
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+private:
+	void DrainMoveQueues();
+	void AddMoveCost(uint64 Cycles, int32 NumMoves);
+	void Gather();
+	void Integrate();
+	void WriteBack();
+
+	UPROPERTY()
+	TArray<AGoKart*> Karts;
+
+	// Karts with moves this frame, most moves first, in the same order as the arrays below
+	TArray<AGoKart*> BatchKarts;
+
+	// Per kart
+	TArray<FGoKartSimConstants> Constants;
+	TArray<FVector> StartLocations;
+	TArray<FVector> Locations;
+	TArray<FQuat> Rotations;
+	TArray<FVector> Velocities;
+	TArray<int32> FirstMoves;
+	TArray<int32> NumMoves;
+
+	// All queued moves, kart by kart
+	TArray<FGoKartMove> Moves;
+
+	// Kernel lanes for each ParallelFor chunk, kept between frames
+	TArray<FGoKartKernelBatch> Chunks;
+
+	// Smoothed game thread ms to simulate one move, 0 until measured
+	float MoveCostMs{};
+};
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartSnapshotBuffer.h"
+
+namespace
+{
+	// How far past the newest snapshot we keep going on its velocity before holding position
+	constexpr double MaxExtrapolationTime = 0.25;
+
+	// Weight of the newest interval in the running average
+	constexpr float IntervalSmoothing = 0.1f;
+}
+
+void FGoKartSnapshotBuffer::Init(int32 Capacity)
+{
+	Snapshots.Init(Capacity);
+	ClockOffset.Reset();
+}
+
+void FGoKartSnapshotBuffer::Add(double Time, double ReceiveTime, const FVector& Location, const FQuat& Rotation, const FVector& Velocity)
+{
+	if (!Snapshots.IsEmpty() && Time <= Snapshots.Last().Time)
+	{
+		return;
+	}
+
+	ClockOffset.Add(ReceiveTime, Time);
+
+	if (!Snapshots.IsEmpty())
+	{
+		const float Interval = float(Time - Snapshots.Last().Time);
+		AverageInterval = AverageInterval > 0.f ? FMath::Lerp(AverageInterval, Interval, IntervalSmoothing) : Interval;
+	}
+
+	Snapshots.Push({ Time, Location, Rotation, Velocity });
+}
+
+bool FGoKartSnapshotBuffer::Sample(double LocalTime, float Delay, FVector& OutLocation, FQuat& OutRotation) const
+{
+	if (Snapshots.IsEmpty())
+	{
+		return false;
+	}
+
+	const double Time = LocalTime - ClockOffset.Get() - Delay;
+	const FGoKartSnapshot& Newest = Snapshots.Last();
+	if (Time >= Newest.Time)
+	{
+		const double ExtrapolationTime = FMath::Min(Time - Newest.Time, MaxExtrapolationTime);
+		OutLocation = Newest.Location + Newest.Velocity * 100.f * float(ExtrapolationTime);
+		OutRotation = Newest.Rotation;
+		return true;
+	}
+
+	for (int32 Index = Snapshots.Num() - 2; Index >= 0; --Index)
+	{
+		const FGoKartSnapshot& From = Snapshots[Index];
+		if (Time >= From.Time)
+		{
+			const FGoKartSnapshot Sample{ GoKartInterpolation::Sample(From, Snapshots[Index + 1], Time) };
+			OutLocation = Sample.Location;
+			OutRotation = Sample.Rotation;
+			return true;
+		}
+	}
+
+	// Older than anything we still have
+	OutLocation = Snapshots[0].Location;
+	OutRotation = Snapshots[0].Rotation;
+	return true;
+}
@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartRingBuffer.h"
+#include "GoKartInterpolation.h"
+
+/**
+ * Timestamped server states for one simulated proxy. Sample() plays them back a fixed delay
+ * behind the newest one, using cubic Hermite interpolation with the replicated velocity as tangents.
+ */
+class FGoKartSnapshotBuffer
+{
+public:
+	void Init(int32 Capacity);
+
+	// Time is the TimeStamp of the move the server state was produced by. Out of order snapshots are ignored.
+	void Add(double Time, double ReceiveTime, const FVector& Location, const FQuat& Rotation, const FVector& Velocity);
+
+	// Returns false until the first snapshot arrives. LocalTime uses the same clock as ReceiveTime.
+	bool Sample(double LocalTime, float Delay, FVector& OutLocation, FQuat& OutRotation) const;
+
+	// Smoothed time between received snapshots, 0 until two have arrived
+	float GetAverageInterval() const { return AverageInterval; }
+
+private:
+	TGoKartRingBuffer<FGoKartSnapshot> Snapshots; // Time is on the owning client's move clock
+
+	// Local clock minus move clock
+	FGoKartClockOffset ClockOffset;
+
+	float AverageInterval{};
+};
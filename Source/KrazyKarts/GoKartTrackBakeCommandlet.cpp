@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartTrackBakeCommandlet.h"
+
+#include "KrazyKarts.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Misc/PackageName.h"
+#include "PhysicsEngine/BodySetup.h"
+
+namespace
+{
+	void AddBox(const FTransform& ComponentTransform, const FTransform& LocalTransform, const FVector& LocalExtent, TArray<FGoKartTrackBox>& OutBoxes)
+	{
+		// Exact for uniform scale, and for non-uniform scale unless a shape is rotated inside its component
+		FGoKartTrackBox& Box = OutBoxes.AddDefaulted_GetRef();
+		Box.Center = ComponentTransform.TransformPosition(LocalTransform.GetLocation());
+		Box.Rotation = ComponentTransform.GetRotation() * LocalTransform.GetRotation();
+		Box.Extent = LocalExtent * LocalTransform.GetScale3D().GetAbs() * ComponentTransform.GetScale3D().GetAbs();
+	}
+}
+
+UGoKartTrackBakeCommandlet::UGoKartTrackBakeCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UGoKartTrackBakeCommandlet::Main(const FString& Params)
+{
+	FString MapPath{ TEXT("/Game/VehicleCPP/Maps/VehicleExampleMap") };
+	FParse::Value(*Params, TEXT("Map="), MapPath);
+
+	UPackage* Package = LoadPackage(nullptr, *MapPath, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogKrazyKarts, Error, TEXT("GoKartTrackBake: could not load map %s"), *MapPath);
+		return 1;
+	}
+
+	// Components need registering for their world transforms, nothing else of the world is needed
+	World->AddToRoot();
+	World->WorldType = EWorldType::Editor;
+	World->InitWorld(UWorld::InitializationValues()
+		.InitializeScenes(false)
+		.AllowAudioPlayback(false)
+		.RequiresHitProxies(false)
+		.CreatePhysicsScene(false)
+		.CreateNavigation(false)
+		.CreateAISystem(false)
+		.ShouldSimulatePhysics(false)
+		.EnableTraceCollision(false)
+		.SetTransactional(false)
+		.CreateFXSystems(false));
+	World->UpdateWorldComponents(true, false);
+
+	TArray<FGoKartTrackBox> Boxes;
+	TArray<FString> ComponentNames;
+	int32 NumSkipped = 0;
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		for (UActorComponent* Component : It->GetComponents())
+		{
+			UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+			if (!Primitive || Primitive->Mobility != EComponentMobility::Static
+				|| !CollisionEnabledHasQuery(Primitive->GetCollisionEnabled())
+				|| Primitive->GetCollisionResponseToChannel(ECC_Pawn) != ECR_Block)
+			{
+				continue;
+			}
+
+			if (AddComponentBoxes(*Primitive, Boxes))
+			{
+				ComponentNames.Add(It->GetName() + TEXT(".") + Primitive->GetName());
+			}
+			else
+			{
+				UE_LOG(LogKrazyKarts, Display, TEXT("GoKartTrackBake: %s.%s has no simple collision, karts keep sweeping it with PhysX"), *It->GetName(), *Primitive->GetName());
+				++NumSkipped;
+			}
+		}
+	}
+
+	World->CleanupWorld();
+	World->RemoveFromRoot();
+
+	FGoKartTrackCollision Collision;
+	const int32 NumComponents = ComponentNames.Num();
+	Collision.Build(MoveTemp(Boxes), MoveTemp(ComponentNames));
+
+	const FString Filename{ FGoKartTrackCollision::GetFilename(FPackageName::GetShortName(MapPath)) };
+	if (!Collision.Save(Filename))
+	{
+		UE_LOG(LogKrazyKarts, Error, TEXT("GoKartTrackBake: could not write %s"), *Filename);
+		return 1;
+	}
+
+	UE_LOG(LogKrazyKarts, Display, TEXT("GoKartTrackBake: wrote %s: %d components (%d left to PhysX), %d boxes, %d nodes, %d KB"),
+		*Filename, NumComponents, NumSkipped, Collision.NumBoxes(), Collision.NumNodes(), int32(Collision.GetAllocatedSize() / 1024));
+	return 0;
+}
+
+bool UGoKartTrackBakeCommandlet::AddComponentBoxes(UPrimitiveComponent& Component, TArray<FGoKartTrackBox>& OutBoxes) const
+{
+	const UBodySetup* BodySetup = Component.GetBodySetup();
+	if (!BodySetup || BodySetup->GetCollisionTraceFlag() == CTF_UseComplexAsSimple || BodySetup->AggGeom.GetElementCount() == 0)
+	{
+		return false;
+	}
+
+	const FTransform& ComponentTransform = Component.GetComponentTransform();
+	const FKAggregateGeom& Geom = BodySetup->AggGeom;
+	for (const FKBoxElem& Elem : Geom.BoxElems)
+	{
+		AddBox(ComponentTransform, Elem.GetTransform(), FVector(Elem.X, Elem.Y, Elem.Z) * 0.5f, OutBoxes);
+	}
+	for (const FKSphereElem& Elem : Geom.SphereElems)
+	{
+		AddBox(ComponentTransform, Elem.GetTransform(), FVector(Elem.Radius), OutBoxes);
+	}
+	for (const FKSphylElem& Elem : Geom.SphylElems)
+	{
+		AddBox(ComponentTransform, Elem.GetTransform(), FVector(Elem.Radius, Elem.Radius, Elem.Length * 0.5f + Elem.Radius), OutBoxes);
+	}
+	for (const FKTaperedCapsuleElem& Elem : Geom.TaperedCapsuleElems)
+	{
+		const float Radius = FMath::Max(Elem.Radius0, Elem.Radius1);
+		AddBox(ComponentTransform, Elem.GetTransform(), FVector(Radius, Radius, Elem.Length * 0.5f + Radius), OutBoxes);
+	}
+	for (const FKConvexElem& Elem : Geom.ConvexElems)
+	{
+		// The hull's bounding box, which is exact for the box-shaped blocks tracks are usually built from
+		const FTransform ElemTransform{ Elem.GetTransform() };
+		const FTransform BoxTransform{ ElemTransform.GetRotation(), ElemTransform.TransformPosition(Elem.ElemBox.GetCenter()), ElemTransform.GetScale3D() };
+		AddBox(ComponentTransform, BoxTransform, Elem.ElemBox.GetExtent(), OutBoxes);
+	}
+	return true;
+}
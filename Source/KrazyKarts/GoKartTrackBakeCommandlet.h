@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GoKartTrackCollision.h"
+#include "GoKartTrackBakeCommandlet.generated.h"
+
+class UPrimitiveComponent;
+
+/**
+ * Bakes the static collision of a map into an FGoKartTrackCollision file that karts sweep
+ * against instead of PhysX. Every static component that blocks pawns and has simple collision
+ * contributes one oriented box per shape; components with only complex collision are listed
+ * and left to PhysX. Rerun whenever the level's static geometry changes.
+ *
+ * UE4Editor-Cmd KrazyKarts.uproject -run=GoKartTrackBake [-Map=/Game/VehicleCPP/Maps/VehicleExampleMap]
+ */
+UCLASS()
+class UGoKartTrackBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGoKartTrackBakeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	// False when the component has no simple shapes to bake
+	bool AddComponentBoxes(UPrimitiveComponent& Component, TArray<FGoKartTrackBox>& OutBoxes) const;
+};
@@ -0,0 +1,298 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartTrackCollision.h"
+
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	constexpr uint32 TrackCollisionMagic = 0x43544B4B; // "KKTC"
+	constexpr uint32 TrackCollisionVersion = 1;
+
+	constexpr int32 MaxBoxesPerLeaf = 4;
+
+	// Deep enough for any tree built from MaxBoxesPerLeaf leaves with median splits
+	constexpr int32 MaxTraversalDepth = 64;
+
+	// cm a kart may touch or sink into a box without being blocked, and backs off from a hit
+	constexpr float Skin = 1.f;
+
+	FVector GetWorldExtent(const FQuat& Rotation, const FVector& Extent)
+	{
+		const FVector X{ Rotation.GetAxisX() * Extent.X };
+		const FVector Y{ Rotation.GetAxisY() * Extent.Y };
+		const FVector Z{ Rotation.GetAxisZ() * Extent.Z };
+		return X.GetAbs() + Y.GetAbs() + Z.GetAbs();
+	}
+
+	// True if Start + t * Delta touches [Min, Max] for some t in [0, MaxTime], including when it starts inside
+	bool SegmentOverlapsBox(const FVector& Start, const FVector& Delta, const FVector& Min, const FVector& Max, float MaxTime)
+	{
+		float Enter = 0.f;
+		float Exit = MaxTime;
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			if (FMath::Abs(Delta[Axis]) < KINDA_SMALL_NUMBER)
+			{
+				if (Start[Axis] < Min[Axis] || Start[Axis] > Max[Axis])
+				{
+					return false;
+				}
+				continue;
+			}
+			const float InvDelta = 1.f / Delta[Axis];
+			float T0 = (Min[Axis] - Start[Axis]) * InvDelta;
+			float T1 = (Max[Axis] - Start[Axis]) * InvDelta;
+			if (T0 > T1)
+			{
+				Swap(T0, T1);
+			}
+			Enter = FMath::Max(Enter, T0);
+			Exit = FMath::Min(Exit, T1);
+			if (Enter > Exit)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Time the segment enters [-Extent, Extent] and the axis it enters through. False if it misses or starts inside.
+	bool EnterLocalBox(const FVector& Start, const FVector& Delta, const FVector& Extent, float MaxTime, float& OutTime, int32& OutAxis)
+	{
+		float Enter = 0.f;
+		float Exit = MaxTime;
+		int32 EnterAxis = INDEX_NONE;
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			if (FMath::Abs(Delta[Axis]) < KINDA_SMALL_NUMBER)
+			{
+				if (Start[Axis] <= -Extent[Axis] || Start[Axis] >= Extent[Axis])
+				{
+					return false;
+				}
+				continue;
+			}
+			const float InvDelta = 1.f / Delta[Axis];
+			float T0 = (-Extent[Axis] - Start[Axis]) * InvDelta;
+			float T1 = (Extent[Axis] - Start[Axis]) * InvDelta;
+			if (T0 > T1)
+			{
+				Swap(T0, T1);
+			}
+			if (T0 > Enter)
+			{
+				Enter = T0;
+				EnterAxis = Axis;
+			}
+			Exit = FMath::Min(Exit, T1);
+			if (Enter > Exit)
+			{
+				return false;
+			}
+		}
+
+		OutTime = Enter;
+		OutAxis = EnterAxis;
+		return EnterAxis != INDEX_NONE;
+	}
+}
+
+FString FGoKartTrackCollision::GetFilename(const FString& MapName)
+{
+	return FPaths::ProjectContentDir() / TEXT("TrackCollision") / MapName + TEXT(".kktrack");
+}
+
+void FGoKartTrackCollision::Build(TArray<FGoKartTrackBox>&& InBoxes, TArray<FString>&& InComponentNames)
+{
+	Nodes.Reset();
+	Boxes.Reset();
+	ComponentNames = MoveTemp(InComponentNames);
+	if (InBoxes.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<FBox> Bounds;
+	TArray<int32> Order;
+	for (int32 Index = 0; Index < InBoxes.Num(); ++Index)
+	{
+		const FVector WorldExtent{ GetWorldExtent(InBoxes[Index].Rotation, InBoxes[Index].Extent) };
+		Bounds.Add(FBox(InBoxes[Index].Center - WorldExtent, InBoxes[Index].Center + WorldExtent));
+		Order.Add(Index);
+	}
+
+	Nodes.AddDefaulted();
+	BuildNode(0, 0, Order.Num(), Bounds, Order);
+
+	// Store the boxes in leaf order so every leaf is one contiguous run
+	Boxes.Reserve(Order.Num());
+	for (int32 Index : Order)
+	{
+		Boxes.Add(InBoxes[Index]);
+	}
+	Nodes.Shrink();
+}
+
+void FGoKartTrackCollision::BuildNode(int32 NodeIndex, int32 First, int32 Num, const TArray<FBox>& Bounds, TArray<int32>& Order)
+{
+	FBox NodeBounds{ ForceInit };
+	FBox Centroids{ ForceInit };
+	for (int32 Index = First; Index < First + Num; ++Index)
+	{
+		NodeBounds += Bounds[Order[Index]];
+		Centroids += Bounds[Order[Index]].GetCenter();
+	}
+	Nodes[NodeIndex].Min = NodeBounds.Min;
+	Nodes[NodeIndex].Max = NodeBounds.Max;
+
+	if (Num <= MaxBoxesPerLeaf)
+	{
+		Nodes[NodeIndex].FirstChildOrBox = First;
+		Nodes[NodeIndex].NumBoxes = Num;
+		return;
+	}
+
+	// Median split along the widest spread of box centres
+	const FVector Spread{ Centroids.GetSize() };
+	const int32 Axis = Spread.X >= Spread.Y && Spread.X >= Spread.Z ? 0 : (Spread.Y >= Spread.Z ? 1 : 2);
+	Sort(Order.GetData() + First, Num, [&Bounds, Axis](int32 A, int32 B)
+	{
+		return Bounds[A].GetCenter()[Axis] < Bounds[B].GetCenter()[Axis];
+	});
+
+	const int32 FirstChild = Nodes.AddDefaulted(2);
+	Nodes[NodeIndex].FirstChildOrBox = FirstChild;
+	Nodes[NodeIndex].NumBoxes = 0;
+	BuildNode(FirstChild, First, Num / 2, Bounds, Order);
+	BuildNode(FirstChild + 1, First + Num / 2, Num - Num / 2, Bounds, Order);
+}
+
+bool FGoKartTrackCollision::Sweep(const FVector& Start, const FVector& Delta, const FVector& KartExtent, float& OutTime, FVector& OutNormal) const
+{
+	if (Nodes.Num() == 0 || Delta.IsNearlyZero())
+	{
+		return false;
+	}
+
+	float BestTime = 1.f;
+	int32 BestBox = INDEX_NONE;
+	int32 BestAxis = INDEX_NONE;
+
+	int32 Stack[MaxTraversalDepth];
+	int32 StackSize = 0;
+	Stack[StackSize++] = 0;
+	while (StackSize > 0)
+	{
+		const FNode& Node = Nodes[Stack[--StackSize]];
+		if (!SegmentOverlapsBox(Start, Delta, Node.Min - KartExtent, Node.Max + KartExtent, BestTime))
+		{
+			continue;
+		}
+
+		if (Node.NumBoxes == 0)
+		{
+			if (StackSize + 2 <= MaxTraversalDepth)
+			{
+				Stack[StackSize++] = Node.FirstChildOrBox;
+				Stack[StackSize++] = Node.FirstChildOrBox + 1;
+			}
+			continue;
+		}
+
+		for (int32 Index = Node.FirstChildOrBox; Index < Node.FirstChildOrBox + Node.NumBoxes; ++Index)
+		{
+			// Grow the box by the kart's reach along each of its own axes, then it is a point sweep
+			const FGoKartTrackBox& Box = Boxes[Index];
+			const FVector LocalStart{ Box.Rotation.UnrotateVector(Start - Box.Center) };
+			const FVector LocalDelta{ Box.Rotation.UnrotateVector(Delta) };
+			const FVector Reach{ GetWorldExtent(Box.Rotation.Inverse(), KartExtent) };
+			const FVector Extent{ Box.Extent + Reach - FVector(Skin) };
+
+			float Time;
+			int32 Axis;
+			if (EnterLocalBox(LocalStart, LocalDelta, Extent, BestTime, Time, Axis) && Time < BestTime)
+			{
+				BestTime = Time;
+				BestBox = Index;
+				BestAxis = Axis;
+			}
+		}
+	}
+
+	if (BestBox == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const FGoKartTrackBox& Box = Boxes[BestBox];
+	FVector LocalNormal{ FVector::ZeroVector };
+	LocalNormal[BestAxis] = Box.Rotation.UnrotateVector(Delta)[BestAxis] > 0.f ? -1.f : 1.f;
+	OutNormal = Box.Rotation.RotateVector(LocalNormal);
+	OutTime = FMath::Max(BestTime - Skin / Delta.Size(), 0.f);
+	return true;
+}
+
+SIZE_T FGoKartTrackCollision::GetAllocatedSize() const
+{
+	SIZE_T Size = Nodes.GetAllocatedSize() + Boxes.GetAllocatedSize() + ComponentNames.GetAllocatedSize();
+	for (const FString& Name : ComponentNames)
+	{
+		Size += Name.GetAllocatedSize();
+	}
+	return Size;
+}
+
+bool FGoKartTrackCollision::SerializeData(FArchive& Ar)
+{
+	uint32 Magic = TrackCollisionMagic;
+	uint32 Version = TrackCollisionVersion;
+	Ar << Magic << Version;
+	if (Magic != TrackCollisionMagic || Version != TrackCollisionVersion)
+	{
+		return false;
+	}
+
+	Ar << Nodes << Boxes << ComponentNames;
+	return !Ar.IsError();
+}
+
+bool FGoKartTrackCollision::Save(const FString& Filename)
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer{ Data };
+	SerializeData(Writer);
+	return FFileHelper::SaveArrayToFile(Data, *Filename);
+}
+
+bool FGoKartTrackCollision::Load(const FString& Filename)
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Filename, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader{ Data };
+	bool bValid = SerializeData(Reader);
+
+	// Indices are trusted by Sweep, so reject a file whose tree does not fit its arrays. Children always
+	// come after their parent, which also rules out cycles.
+	for (int32 Index = 0; Index < Nodes.Num(); ++Index)
+	{
+		const FNode& Node = Nodes[Index];
+		bValid &= Node.NumBoxes > 0
+			? Node.FirstChildOrBox >= 0 && Node.FirstChildOrBox + Node.NumBoxes <= Boxes.Num()
+			: Node.FirstChildOrBox > Index && Node.FirstChildOrBox + 1 < Nodes.Num();
+	}
+
+	if (!bValid)
+	{
+		Nodes.Reset();
+		Boxes.Reset();
+		ComponentNames.Reset();
+	}
+	return bValid;
+}
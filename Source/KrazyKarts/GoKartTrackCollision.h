@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// One oriented collision box of the baked track, in world space
+struct FGoKartTrackBox
+{
+	FVector Center{ FVector::ZeroVector };
+	FVector Extent{ FVector::ZeroVector };
+	FQuat Rotation{ FQuat::Identity };
+
+	friend FArchive& operator<<(FArchive& Ar, FGoKartTrackBox& Box)
+	{
+		return Ar << Box.Center << Box.Extent << Box.Rotation;
+	}
+};
+
+/**
+ * Static level collision baked offline by GoKartTrackBake into oriented boxes under a flat
+ * bounding volume hierarchy, so a kart move can be swept against the track without a PhysX
+ * scene query. Also lists the components the boxes came from, which karts then leave out of
+ * their own sweeps. Components with only complex (per triangle) collision and landscapes are
+ * not baked and stay with PhysX.
+ */
+class KRAZYKARTS_API FGoKartTrackCollision
+{
+public:
+	// Content/TrackCollision/<MapName>.kktrack, staged as a loose file
+	static FString GetFilename(const FString& MapName);
+
+	void Build(TArray<FGoKartTrackBox>&& InBoxes, TArray<FString>&& InComponentNames);
+
+	bool Save(const FString& Filename);
+	bool Load(const FString& Filename);
+
+	bool IsEmpty() const { return Boxes.Num() == 0; }
+	int32 NumBoxes() const { return Boxes.Num(); }
+	int32 NumNodes() const { return Nodes.Num(); }
+	SIZE_T GetAllocatedSize() const;
+
+	// "ActorName.ComponentName" of every baked component
+	const TArray<FString>& GetComponentNames() const { return ComponentNames; }
+
+	// Sweeps a world aligned box of KartExtent from Start by Delta. On a blocking hit returns true with OutTime,
+	// the fraction of Delta that can be moved, already backed off by a small skin, and the surface normal.
+	// A kart resting on a box or already inside one is not blocked by it, so it can always drive out.
+	bool Sweep(const FVector& Start, const FVector& Delta, const FVector& KartExtent, float& OutTime, FVector& OutNormal) const;
+
+private:
+	// Leaf when NumBoxes > 0, otherwise its two children are at FirstChildOrBox and FirstChildOrBox + 1
+	struct FNode
+	{
+		FVector Min{ FVector::ZeroVector };
+		FVector Max{ FVector::ZeroVector };
+		int32 FirstChildOrBox{};
+		int32 NumBoxes{};
+
+		friend FArchive& operator<<(FArchive& Ar, FNode& Node)
+		{
+			return Ar << Node.Min << Node.Max << Node.FirstChildOrBox << Node.NumBoxes;
+		}
+	};
+
+	void BuildNode(int32 NodeIndex, int32 First, int32 Num, const TArray<FBox>& Bounds, TArray<int32>& Order);
+	bool SerializeData(FArchive& Ar);
+
+	TArray<FNode> Nodes;
+	TArray<FGoKartTrackBox> Boxes; // in leaf order
+	TArray<FString> ComponentNames;
+};
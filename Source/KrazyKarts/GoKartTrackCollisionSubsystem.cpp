@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartTrackCollisionSubsystem.h"
+
+#include "KrazyKarts.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarTrackCollision(
+		TEXT("kk.Sim.TrackCollision"),
+		1,
+		TEXT("Sweep kart moves against the track collision baked with GoKartTrackBake instead of the static PhysX scene. Read when a map starts."));
+}
+
+bool UGoKartTrackCollisionSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UGoKartTrackCollisionSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (CVarTrackCollision.GetValueOnGameThread() == 0)
+	{
+		return;
+	}
+
+	const FString MapName{ UWorld::RemovePIEPrefix(InWorld.GetMapName()) };
+	const FString Filename{ FGoKartTrackCollision::GetFilename(MapName) };
+	if (!Collision.Load(Filename))
+	{
+		UE_LOG(LogKrazyKarts, Log, TEXT("No baked track collision for %s, karts sweep against PhysX only"), *MapName);
+		return;
+	}
+
+	TSet<FString> ComponentNames;
+	ComponentNames.Append(Collision.GetComponentNames());
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		for (UActorComponent* Component : It->GetComponents())
+		{
+			UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+			if (Primitive && ComponentNames.Contains(It->GetName() + TEXT(".") + Primitive->GetName()))
+			{
+				BakedComponents.Add(Primitive);
+			}
+		}
+	}
+
+	// A missing component means the level changed since the bake, and the data may no longer match it
+	UE_CLOG(BakedComponents.Num() != ComponentNames.Num(), LogKrazyKarts, Warning, TEXT("Track collision %s lists %d components but %d were found, rebake with GoKartTrackBake"),
+		*Filename, ComponentNames.Num(), BakedComponents.Num());
+	UE_LOG(LogKrazyKarts, Display, TEXT("Loaded track collision for %s: %d boxes, %d nodes, %d KB"),
+		*MapName, Collision.NumBoxes(), Collision.NumNodes(), int32(Collision.GetAllocatedSize() / 1024));
+}
+
+void UGoKartTrackCollisionSubsystem::IgnoreBakedComponents(UPrimitiveComponent* Component) const
+{
+	for (UPrimitiveComponent* Baked : BakedComponents)
+	{
+		if (Baked)
+		{
+			Component->IgnoreComponentWhenMoving(Baked, true);
+		}
+	}
+}
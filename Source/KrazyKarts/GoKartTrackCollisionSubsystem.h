@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GoKartTrackCollision.h"
+#include "GoKartTrackCollisionSubsystem.generated.h"
+
+class UPrimitiveComponent;
+
+/**
+ * Loads the track collision baked for the current map by GoKartTrackBake, if there is one,
+ * when play begins. Karts sweep their moves against it and leave the baked components out of
+ * their PhysX sweeps, which then only find dynamic objects and unbaked geometry. Disabled with
+ * kk.Sim.TrackCollision 0, which takes effect on the next map load.
+ */
+UCLASS()
+class UGoKartTrackCollisionSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	bool IsLoaded() const { return !Collision.IsEmpty(); }
+	const FGoKartTrackCollision& GetCollision() const { return Collision; }
+
+	// Makes Component's sweeps skip everything the baked collision already covers
+	void IgnoreBakedComponents(UPrimitiveComponent* Component) const;
+
+private:
+	FGoKartTrackCollision Collision;
+
+	UPROPERTY()
+	TArray<UPrimitiveComponent*> BakedComponents;
+};
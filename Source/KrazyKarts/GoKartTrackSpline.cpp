@@ -0,0 +1,13 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartTrackSpline.h"
+
+#include "Components/SplineComponent.h"
+
+AGoKartTrackSpline::AGoKartTrackSpline()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	Spline = CreateDefaultSubobject<USplineComponent>(TEXT("Spline"));
+	Spline->SetClosedLoop(true);
+	RootComponent = Spline;
+}
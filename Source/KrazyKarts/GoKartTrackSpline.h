@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GoKartTrackSpline.generated.h"
+
+class USplineComponent;
+
+/**
+ * Racing line around the track, placed in the map. UGoKartBotSubsystem samples the first one
+ * it finds and drives bots along it in the direction of its points.
+ */
+UCLASS()
+class KRAZYKARTS_API AGoKartTrackSpline : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartTrackSpline();
+
+	USplineComponent* GetSpline() const { return Spline; }
+
+private:
+	UPROPERTY(VisibleAnywhere)
+	USplineComponent* Spline;
+};
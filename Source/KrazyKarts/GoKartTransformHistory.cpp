@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "GoKartTransformHistory.h"
+
+void FGoKartTransformHistory::Init(int32 Capacity)
+{
+	Samples.Init(Capacity);
+	ClockOffset.Reset();
+}
+
+void FGoKartTransformHistory::AddClientTime(double ServerTime, double ClientTime)
+{
+	ClockOffset.Add(ServerTime, ClientTime);
+}
+
+void FGoKartTransformHistory::Add(double ServerTime, const FVector& Location, const FQuat& Rotation, const FVector& Velocity)
+{
+	if (!Samples.IsEmpty() && ServerTime <= Samples.Last().Time)
+	{
+		Samples.Last() = { Samples.Last().Time, Location, Rotation, Velocity };
+		return;
+	}
+	Samples.Push({ ServerTime, Location, Rotation, Velocity });
+}
+
+void FGoKartTransformHistory::Trim(double OldestTime)
+{
+	int32 NumExpired = 0;
+	while (NumExpired + 1 < Samples.Num() && Samples[NumExpired + 1].Time <= OldestTime)
+	{
+		++NumExpired;
+	}
+	Samples.PopFront(NumExpired);
+}
+
+bool FGoKartTransformHistory::Sample(double Time, FGoKartSnapshot& OutSample, int32& InOutCursor) const
+{
+	if (Samples.IsEmpty())
+	{
+		return false;
+	}
+
+	if (Time < Samples[0].Time)
+	{
+		OutSample = Samples[0];
+		return false;
+	}
+	if (Time >= Samples.Last().Time)
+	{
+		OutSample = Samples.Last();
+		return Time == Samples.Last().Time;
+	}
+
+	// Restart the walk for a time earlier than the previous one
+	int32 Index = FMath::Clamp(InOutCursor, 0, Samples.Num() - 2);
+	if (Samples[Index].Time > Time)
+	{
+		Index = 0;
+	}
+	while (Index + 2 < Samples.Num() && Samples[Index + 1].Time <= Time)
+	{
+		++Index;
+	}
+	InOutCursor = Index;
+
+	OutSample = GoKartInterpolation::Sample(Samples[Index], Samples[Index + 1], Time);
+	return true;
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartRingBuffer.h"
+#include "GoKartInterpolation.h"
+
+/**
+ * Where one kart was on the server, at most one sample per server frame, in a fixed ring buffer.
+ * Sample() interpolates with GoKartInterpolation, like FGoKartSnapshotBuffer. Also tracks the
+ * offset from the owning client's move clock to the server time its moves arrive at, which
+ * UGoKartLagCompensationSubsystem::GetServerTime turns into the server time to rewind to.
+ */
+class FGoKartTransformHistory
+{
+public:
+	void Init(int32 Capacity);
+
+	// Several moves applied in one server frame replace each other, so the buffer spans frames rather than moves
+	void Add(double ServerTime, const FVector& Location, const FQuat& Rotation, const FVector& Velocity);
+
+	// A move stamped ClientTime arrived at ServerTime. Call on receipt, so time spent queued on the server is not counted.
+	void AddClientTime(double ServerTime, double ClientTime);
+
+	// Drops samples older than OldestTime, keeping the one just before it so OldestTime can still be sampled
+	void Trim(double OldestTime);
+
+	// InOutCursor starts at 0 and only moves forward, so samples at increasing times cost one walk of the
+	// buffer in total. Returns false when Time is outside the recorded range, with the nearest end in OutSample.
+	bool Sample(double Time, FGoKartSnapshot& OutSample, int32& InOutCursor) const;
+
+	// Server time a move stamped ClientTime arrives at over the fastest delivery seen: when the client made it plus the
+	// one-way trip. Later than anything the client was looking at when it made the move.
+	double ToServerTime(double ClientTime) const { return ClientTime + ClockOffset.Get(); }
+
+	bool HasClockOffset() const { return ClockOffset.IsSet(); }
+	bool IsEmpty() const { return Samples.IsEmpty(); }
+
+private:
+	TGoKartRingBuffer<FGoKartSnapshot> Samples; // Time is server time
+
+	// Server receive time minus client move time
+	FGoKartClockOffset ClockOffset;
+};
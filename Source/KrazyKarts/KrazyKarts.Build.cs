@@ -8,7 +8,10 @@ public class KrazyKarts : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "PhysXVehicles", "HeadMountedDisplay" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "PhysXVehicles", "HeadMountedDisplay", "ReplicationGraph", "AIModule" });
+
+		// The vehicle LOD writes sub-step counts straight into the PhysX vehicle
+		SetupModulePhysicsSupport(Target);
 
 		PublicDefinitions.Add("HMD_MODULE_INCLUDED=1");
 	}
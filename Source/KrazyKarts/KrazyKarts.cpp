@@ -4,4 +4,7 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, KrazyKarts, "KrazyKarts" );
- 
\ No newline at end of file
+
+DEFINE_LOG_CATEGORY(LogKrazyKarts);
+
+CSV_DEFINE_CATEGORY_MODULE(KRAZYKARTS_API, KrazyKarts, true);
@@ -2,4 +2,16 @@
 
 #pragma once
 
-#include "CoreMinimal.h"
\ No newline at end of file
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogKrazyKarts, Log, All);
+
+// Debug visualisation, compiled out of Shipping and dedicated servers
+#define WITH_GOKART_DEBUG_DRAW (!UE_BUILD_SHIPPING && !UE_SERVER)
+
+// "stat KrazyKarts". Cycle counters are declared next to the code they time and compile out with STATS.
+DECLARE_STATS_GROUP(TEXT("KrazyKarts"), STATGROUP_KrazyKarts, STATCAT_Advanced);
+
+// Category for CSV_SCOPED_TIMING_STAT and CSV_CUSTOM_STAT in "csvprofile" captures
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(KRAZYKARTS_API, KrazyKarts);
@@ -2,10 +2,15 @@
 
 #include "KrazyKartsGameMode.h"
 #include "KrazyKartsPawn.h"
+#if !UE_SERVER
 #include "KrazyKartsHud.h"
+#endif // !UE_SERVER
 
 AKrazyKartsGameMode::AKrazyKartsGameMode()
 {
 	DefaultPawnClass = AKrazyKartsPawn::StaticClass();
+#if !UE_SERVER
+	// Dedicated servers never draw a HUD
 	HUDClass = AKrazyKartsHud::StaticClass();
+#endif // !UE_SERVER
 }
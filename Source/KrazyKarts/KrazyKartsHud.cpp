@@ -20,8 +20,10 @@
 
 AKrazyKartsHud::AKrazyKartsHud()
 {
+#if !UE_SERVER
 	static ConstructorHelpers::FObjectFinder<UFont> Font(TEXT("/Engine/EngineFonts/RobotoDistanceField"));
 	HUDFont = Font.Object;
+#endif // !UE_SERVER
 }
 
 void AKrazyKartsHud::DrawHUD()
@@ -45,15 +47,26 @@ void AKrazyKartsHud::DrawHUD()
 		{
 			FVector2D ScaleVec(HUDYRatio * 1.4f, HUDYRatio * 1.4f);
 
+			if (!SpeedTextItem.IsSet())
+			{
+				SpeedTextItem.Emplace(FVector2D::ZeroVector, FText::GetEmpty(), HUDFont, FLinearColor::White);
+				GearTextItem.Emplace(FVector2D::ZeroVector, FText::GetEmpty(), HUDFont, FLinearColor::White);
+			}
+
 			// Speed
-			FCanvasTextItem SpeedTextItem(FVector2D(HUDXRatio * 805.f, HUDYRatio * 455), Vehicle->SpeedDisplayString, HUDFont, FLinearColor::White);
-			SpeedTextItem.Scale = ScaleVec;
-			Canvas->DrawItem(SpeedTextItem);
+			FCanvasTextItem& SpeedItem = SpeedTextItem.GetValue();
+			SpeedItem.Position = FVector2D(HUDXRatio * 805.f, HUDYRatio * 455);
+			SpeedItem.Text = Vehicle->SpeedDisplayString;
+			SpeedItem.Scale = ScaleVec;
+			Canvas->DrawItem(SpeedItem);
 
 			// Gear
-			FCanvasTextItem GearTextItem(FVector2D(HUDXRatio * 805.f, HUDYRatio * 500.f), Vehicle->GearDisplayString, HUDFont, Vehicle->bInReverseGear == false ? Vehicle->GearDisplayColor : Vehicle->GearDisplayReverseColor);
-			GearTextItem.Scale = ScaleVec;
-			Canvas->DrawItem(GearTextItem);
+			FCanvasTextItem& GearItem = GearTextItem.GetValue();
+			GearItem.Position = FVector2D(HUDXRatio * 805.f, HUDYRatio * 500.f);
+			GearItem.Text = Vehicle->GearDisplayString;
+			GearItem.SetColor(Vehicle->bInReverseGear == false ? Vehicle->GearDisplayColor : Vehicle->GearDisplayReverseColor);
+			GearItem.Scale = ScaleVec;
+			Canvas->DrawItem(GearItem);
 		}
 	}
 }
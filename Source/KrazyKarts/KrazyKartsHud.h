@@ -1,6 +1,7 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 #pragma once
 #include "GameFramework/HUD.h"
+#include "CanvasItem.h"
 #include "KrazyKartsHud.generated.h"
 
 
@@ -19,4 +20,9 @@ public:
 	// Begin AHUD interface
 	virtual void DrawHUD() override;
 	// End AHUD interface
+
+private:
+	/** Drawn every frame, so kept rather than rebuilt. Built on first draw; FCanvasTextItem has no default constructor */
+	TOptional<FCanvasTextItem> SpeedTextItem;
+	TOptional<FCanvasTextItem> GearTextItem;
 };
@@ -1,9 +1,13 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "KrazyKartsPawn.h"
+#include "KrazyKarts.h"
 #include "KrazyKartsWheelFront.h"
 #include "KrazyKartsWheelRear.h"
 #include "KrazyKartsHud.h"
+#include "KrazyKartsVehicleMovement.h"
+#include "KrazyKartsVehicleManager.h"
+#include "KrazyKartsVehicleMesh.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "Camera/CameraComponent.h"
@@ -15,6 +19,11 @@
 #include "Components/TextRenderComponent.h"
 #include "Materials/Material.h"
 #include "GameFramework/Controller.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "Internationalization/TextLocalizationManager.h"
+#include "Net/UnrealNetwork.h"
+#include "Misc/ScopeExit.h"
 
 #ifndef HMD_MODULE_INCLUDED
 #define HMD_MODULE_INCLUDED 0
@@ -26,14 +35,120 @@
 #include "HeadMountedDisplayFunctionLibrary.h"
 #endif // HMD_MODULE_INCLUDED
 
+DECLARE_CYCLE_STAT(TEXT("KrazyKartsPawn Tick"), STAT_KrazyKartsPawnTick, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("KrazyKartsPawn HUD Strings"), STAT_KrazyKartsPawnHUDStrings, STATGROUP_KrazyKarts);
+DECLARE_CYCLE_STAT(TEXT("KrazyKartsPawn Reconcile"), STAT_KrazyKartsPawnReconcile, STATGROUP_KrazyKarts);
+
 const FName AKrazyKartsPawn::LookUpBinding("LookUp");
 const FName AKrazyKartsPawn::LookRightBinding("LookRight");
 
 #define LOCTEXT_NAMESPACE "VehiclePawn"
 
+namespace
+{
+	// Highest km/h with a prebuilt string, faster speeds are formatted when they are reached
+	constexpr int32 MaxCachedSpeed = 300;
+	constexpr int32 MaxCachedGear = 9;
+
+	// Display strings for every speed and gear, shared by all pawns and rebuilt only when the language changes
+	struct FHUDTextCache
+	{
+		// Returns true if the strings were rebuilt
+		bool Refresh()
+		{
+			const uint16 CurrentRevision = FTextLocalizationManager::Get().GetTextRevision();
+			if (Speeds.Num() > 0 && CurrentRevision == TextRevision)
+			{
+				return false;
+			}
+			TextRevision = CurrentRevision;
+
+			Speeds.Reset(MaxCachedSpeed + 1);
+			for (int32 Speed = 0; Speed <= MaxCachedSpeed; ++Speed)
+			{
+				Speeds.Add(FormatSpeed(Speed));
+			}
+
+			Gears.Reset(MaxCachedGear + 2);
+			Gears.Add(LOCTEXT("ReverseGear", "R"));
+			Gears.Add(LOCTEXT("N", "N"));
+			for (int32 Gear = 1; Gear <= MaxCachedGear; ++Gear)
+			{
+				Gears.Add(FText::AsNumber(Gear));
+			}
+			return true;
+		}
+
+		FText GetSpeed(int32 Speed) const
+		{
+			return Speeds.IsValidIndex(Speed) ? Speeds[Speed] : FormatSpeed(Speed);
+		}
+
+		FText GetGear(int32 Gear) const
+		{
+			// Any reverse gear shows as R
+			const int32 Index = FMath::Max(Gear, -1) + 1;
+			return Gears.IsValidIndex(Index) ? Gears[Index] : FText::AsNumber(Gear);
+		}
+
+	private:
+		static FText FormatSpeed(int32 Speed)
+		{
+			return FText::Format(LOCTEXT("SpeedFormat", "{0} km/h"), FText::AsNumber(Speed));
+		}
+
+		uint16 TextRevision{};
+		TArray<FText> Speeds;
+		TArray<FText> Gears; // reverse, neutral, then forward gears
+	};
+
+	FHUDTextCache HUDTextCache;
+
+	// Upper bound on the redundant move window in one Server_SendMoves call
+	constexpr int32 MaxMovesPerSend = 32;
+
+	// Server states kept per simulated proxy for interpolation
+	constexpr int32 MaxSnapshots = 32;
+
+	// Moves State as a rigid body by the transform taking From onto To, velocities included
+	FKrazyKartsChassisState Rebase(const FKrazyKartsChassisState& State, const FKrazyKartsChassisState& From, const FKrazyKartsChassisState& To)
+	{
+		const FQuat RotationDelta{ To.Rotation * From.Rotation.Inverse() };
+		FKrazyKartsChassisState Result;
+		Result.Location = To.Location + RotationDelta.RotateVector(State.Location - From.Location);
+		Result.Rotation = (RotationDelta * State.Rotation).GetNormalized();
+		Result.LinearVelocity = To.LinearVelocity + RotationDelta.RotateVector(State.LinearVelocity - From.LinearVelocity);
+		Result.AngularVelocity = To.AngularVelocity + RotationDelta.RotateVector(State.AngularVelocity - From.AngularVelocity);
+		Result.EngineRPM = To.EngineRPM + (State.EngineRPM - From.EngineRPM);
+		for (int32 Wheel = 0; Wheel < FKrazyKartsChassisState::NumWheels; ++Wheel)
+		{
+			Result.WheelRotationSpeeds[Wheel] = To.WheelRotationSpeeds[Wheel] + (State.WheelRotationSpeeds[Wheel] - From.WheelRotationSpeeds[Wheel]);
+		}
+		return Result;
+	}
+
+	FKrazyKartsChassisState Interpolate(const FKrazyKartsChassisState& A, const FKrazyKartsChassisState& B, float Alpha)
+	{
+		FKrazyKartsChassisState Result;
+		Result.Location = FMath::Lerp(A.Location, B.Location, Alpha);
+		Result.Rotation = FQuat::Slerp(A.Rotation, B.Rotation, Alpha);
+		Result.LinearVelocity = FMath::Lerp(A.LinearVelocity, B.LinearVelocity, Alpha);
+		Result.AngularVelocity = FMath::Lerp(A.AngularVelocity, B.AngularVelocity, Alpha);
+		Result.EngineRPM = FMath::Lerp(A.EngineRPM, B.EngineRPM, Alpha);
+		for (int32 Wheel = 0; Wheel < FKrazyKartsChassisState::NumWheels; ++Wheel)
+		{
+			Result.WheelRotationSpeeds[Wheel] = FMath::Lerp(A.WheelRotationSpeeds[Wheel], B.WheelRotationSpeeds[Wheel], Alpha);
+		}
+		return Result;
+	}
+}
+
 PRAGMA_DISABLE_DEPRECATION_WARNINGS
 
-AKrazyKartsPawn::AKrazyKartsPawn()
+AKrazyKartsPawn::AKrazyKartsPawn(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer
+		.SetDefaultSubobjectClass<UKrazyKartsVehicleMovement>(AWheeledVehicle::VehicleMovementComponentName)
+		.SetDefaultSubobjectClass<UKrazyKartsVehicleMesh>(AWheeledVehicle::VehicleMeshComponentName))
 {
 	// Car mesh
 	static ConstructorHelpers::FObjectFinder<USkeletalMesh> CarMesh(TEXT("/Game/Vehicle/Sedan/Sedan_SkelMesh.Sedan_SkelMesh"));
@@ -122,6 +237,49 @@ AKrazyKartsPawn::AKrazyKartsPawn()
 	GearDisplayColor = FColor(255, 255, 255, 255);
 
 	bInReverseGear = false;
+	DisplayedSpeed = INDEX_NONE;
+	DisplayedGear = MIN_int32;
+
+	// Moves and ServerState replace the engine's replicated movement and vehicle input state
+	SetReplicateMovement(false);
+	NetUpdateFrequency = 30.f;
+	MoveSendRate = 60.f;
+	MoveRedundancy = 4;
+	MaxUnacknowledgedMoves = 256;
+	MaxLocationError = 15.f;
+	MaxVelocityError = 50.f;
+	MaxRotationError = 0.02f;
+	MaxTimingError = 0.05f;
+	CorrectionBlendTime = 0.2f;
+	MaxBlendedLocationError = 300.f;
+	SnapshotInterpolationDelay = 0.f;
+	NextMoveSequence = 1;
+	TimeSinceMovesSent = 0.f;
+	MovesSinceLastSend = 0;
+	DeltaTimeRemainder = 0.f;
+	CorrectionTimeRemaining = 0.f;
+	SimulatedMoveTime = 0.f;
+	VehicleManager = nullptr;
+	VehicleLOD = EKrazyKartsVehicleLOD::Full;
+}
+
+void AKrazyKartsPawn::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	KartsVehicleMovement = CastChecked<UKrazyKartsVehicleMovement>(GetVehicleMovement());
+
+	// Moves read the inputs the vehicle simulation processed this frame
+	AddTickPrerequisiteComponent(KartsVehicleMovement);
+
+	UnacknowledgedMoves.Init(MaxUnacknowledgedMoves);
+	Snapshots.Init(MaxSnapshots);
+}
+
+void AKrazyKartsPawn::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AKrazyKartsPawn, ServerState);
 }
 
 void AKrazyKartsPawn::SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent)
@@ -194,16 +352,48 @@ void AKrazyKartsPawn::EnableIncarView(const bool bState, const bool bForce)
 
 void AKrazyKartsPawn::Tick(float Delta)
 {
+	SCOPE_CYCLE_COUNTER(STAT_KrazyKartsPawnTick);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, PawnTick);
+	const uint32 StartCycles = FPlatformTime::Cycles();
+	ON_SCOPE_EXIT
+	{
+		if (VehicleManager)
+		{
+			VehicleManager->AddUpdateCost(FPlatformTime::Cycles() - StartCycles, false);
+		}
+	};
+
 	Super::Tick(Delta);
 
+	if (GetLocalRole() == ROLE_AutonomousProxy)
+	{
+		TickAutonomousProxy(Delta);
+	}
+	else if (GetLocalRole() == ROLE_Authority)
+	{
+		TickAuthority(Delta);
+	}
+	else if (GetLocalRole() == ROLE_SimulatedProxy)
+	{
+		InterpolateSnapshots();
+	}
+
 	// Setup the flag to say we are in reverse gear
 	bInReverseGear = GetVehicleMovement()->GetCurrentGear() < 0;
-	
-	// Update the strings used in the hud (incar and onscreen)
-	UpdateHUDStrings();
 
-	// Set the string in the incar hud
-	SetupInCarHUD();
+#if !UE_SERVER
+	// Nobody looks at the displays or cameras on a dedicated server
+	if (IsNetMode(NM_DedicatedServer))
+	{
+		return;
+	}
+	
+	// Update the strings used in the hud (incar and onscreen), and the incar hud only when they change.
+	// Pawns nobody on this machine is looking at skip both.
+	if (IsLocallyViewed() && UpdateHUDStrings())
+	{
+		SetupInCarHUD();
+	}
 
 	bool bHMDActive = false;
 #if HMD_MODULE_INCLUDED
@@ -222,12 +412,32 @@ void AKrazyKartsPawn::Tick(float Delta)
 			InternalCamera->SetRelativeRotation(HeadRotation);
 		}
 	}
+#endif // !UE_SERVER
 }
 
 void AKrazyKartsPawn::BeginPlay()
 {
 	Super::BeginPlay();
 
+	VehicleManager = GetWorld()->GetSubsystem<UKrazyKartsVehicleManager>();
+	if (VehicleManager)
+	{
+		VehicleManager->Register(this);
+	}
+
+	if (IsNetMode(NM_DedicatedServer))
+	{
+		// Camera and in-car display components only matter to a viewer
+		SpringArm->SetComponentTickEnabled(false);
+		Camera->Deactivate();
+		InternalCamera->Deactivate();
+		InCarSpeed->SetVisibility(false);
+		InCarGear->SetVisibility(false);
+		InCarSpeed->SetComponentTickEnabled(false);
+		InCarGear->SetComponentTickEnabled(false);
+		return;
+	}
+
 	bool bEnableInCar = false;
 #if HMD_MODULE_INCLUDED
 	bEnableInCar = UHeadMountedDisplayFunctionLibrary::IsHeadMountedDisplayEnabled();
@@ -235,6 +445,16 @@ void AKrazyKartsPawn::BeginPlay()
 	EnableIncarView(bEnableInCar,true);
 }
 
+void AKrazyKartsPawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (VehicleManager)
+	{
+		VehicleManager->Unregister(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void AKrazyKartsPawn::OnResetVR()
 {
 #if HMD_MODULE_INCLUDED
@@ -247,29 +467,112 @@ void AKrazyKartsPawn::OnResetVR()
 #endif // HMD_MODULE_INCLUDED
 }
 
-void AKrazyKartsPawn::UpdateHUDStrings()
+bool AKrazyKartsPawn::UpdateHUDStrings()
 {
+	SCOPE_CYCLE_COUNTER(STAT_KrazyKartsPawnHUDStrings);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, PawnHUDStrings);
+
 	float KPH = FMath::Abs(GetVehicleMovement()->GetForwardSpeed()) * 0.036f;
 	int32 KPH_int = FMath::FloorToInt(KPH);
+	int32 Gear = GetVehicleMovement()->GetCurrentGear();
+
+	const bool bLanguageChanged = HUDTextCache.Refresh();
+	if (KPH_int == DisplayedSpeed && Gear == DisplayedGear && !bLanguageChanged)
+	{
+		return false;
+	}
+	DisplayedSpeed = KPH_int;
+	DisplayedGear = Gear;
 
 	// Using FText because this is display text that should be localizable
-	SpeedDisplayString = FText::Format(LOCTEXT("SpeedFormat", "{0} km/h"), FText::AsNumber(KPH_int));
-	
-	if (bInReverseGear == true)
+	SpeedDisplayString = HUDTextCache.GetSpeed(KPH_int);
+	GearDisplayString = HUDTextCache.GetGear(Gear);
+	return true;
+}
+
+bool AKrazyKartsPawn::IsLocallyViewed() const
+{
+	if (IsLocallyControlled())
 	{
-		GearDisplayString = FText(LOCTEXT("ReverseGear", "R"));
+		return true;
 	}
-	else
+
+	// Spectating players view a pawn without controlling it
+	for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController* PlayerController = Iterator->Get();
+		if (PlayerController && PlayerController->IsLocalController() && PlayerController->GetViewTarget() == this)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool AKrazyKartsPawn::IsPlayerVehicle() const
+{
+	// The server drives remote players' vehicles from their moves, which must match their prediction
+	return IsLocallyViewed() || (HasAuthority() && IsPlayerControlled());
+}
+
+void AKrazyKartsPawn::SetVehicleLOD(EKrazyKartsVehicleLOD NewLOD)
+{
+	if (NewLOD == VehicleLOD)
+	{
+		return;
+	}
+
+	USkeletalMeshComponent* Chassis = GetMesh();
+	if (VehicleLOD == EKrazyKartsVehicleLOD::Kinematic)
+	{
+		// Carry on from the displayed pose at the server's velocity rather than from rest
+		FKrazyKartsChassisState State{ ServerState.GetChassis() };
+		State.Location = Chassis->GetComponentLocation();
+		State.Rotation = Chassis->GetComponentQuat();
+		Chassis->SetSimulatePhysics(true);
+		SetChassisState(State);
+	}
+
+	switch (NewLOD)
+	{
+	case EKrazyKartsVehicleLOD::Full:
+		KartsVehicleMovement->RestoreSubStepCounts();
+		KartsVehicleMovement->SetSimplifiedTires(false);
+		break;
+	case EKrazyKartsVehicleLOD::Reduced:
+		KartsVehicleMovement->SetSubStepCounts(VehicleManager->ReducedSubSteps, VehicleManager->ReducedSubSteps);
+		KartsVehicleMovement->SetSimplifiedTires(true);
+		break;
+	case EKrazyKartsVehicleLOD::Kinematic:
+		// InterpolateSnapshots keeps posing the chassis
+		Chassis->SetSimulatePhysics(false);
+		break;
+	}
+	VehicleLOD = NewLOD;
+}
+
+void AKrazyKartsPawn::SetUpdateInterval(float Interval, bool bAnimateOffscreen)
+{
+	// Only the wheel bones are animated; the chassis is moved by physics or snapshots either way
+	USkeletalMeshComponent* Chassis = GetMesh();
+	Chassis->SetComponentTickInterval(Interval);
+	Chassis->VisibilityBasedAnimTickOption = bAnimateOffscreen
+		? EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones
+		: EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+
+	// Where this machine drives the vehicle, its moves or server state are built every frame
+	if (GetLocalRole() == ROLE_SimulatedProxy)
 	{
-		int32 Gear = GetVehicleMovement()->GetCurrentGear();
-		GearDisplayString = (Gear == 0) ? LOCTEXT("N", "N") : FText::AsNumber(Gear);
-	}	
+		SetActorTickInterval(Interval);
+	}
 }
 
 void AKrazyKartsPawn::SetupInCarHUD()
 {
-	APlayerController* PlayerController = Cast<APlayerController>(GetController());
-	if ((PlayerController != nullptr) && (InCarSpeed != nullptr) && (InCarGear != nullptr) )
+	SCOPE_CYCLE_COUNTER(STAT_KrazyKartsPawnHUDStrings);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, PawnHUDStrings);
+
+	if ((InCarSpeed != nullptr) && (InCarGear != nullptr))
 	{
 		// Setup the text render component strings
 		InCarSpeed->SetText(SpeedDisplayString);
@@ -286,6 +589,238 @@ void AKrazyKartsPawn::SetupInCarHUD()
 	}
 }
 
+FKrazyKartsVehicleMove AKrazyKartsPawn::CreateMove(float DeltaTime)
+{
+	FKrazyKartsVehicleMove NewMove;
+	KartsVehicleMovement->GetInputs(NewMove.Steering, NewMove.Throttle, NewMove.Brake, NewMove.Handbrake);
+	NewMove.Gear = KartsVehicleMovement->GetCurrentGear();
+	NewMove.DeltaTime = DeltaTime + DeltaTimeRemainder;
+	NewMove.TimeStamp = GetWorld()->TimeSeconds;
+	NewMove.Sequence = NextMoveSequence++;
+	NewMove.Quantize();
+	DeltaTimeRemainder = DeltaTime + DeltaTimeRemainder - NewMove.DeltaTime;
+	return NewMove;
+}
+
+void AKrazyKartsPawn::TickAutonomousProxy(float DeltaTime)
+{
+	BlendCorrection(DeltaTime);
+
+	// Each move records the chassis as physics left it at the move's time stamp, with any correction still being
+	// blended in counted as done, so the same error is not measured twice.
+	// Oldest moves are dropped if the server stops acking; they can then no longer be reconciled
+	UnacknowledgedMoves.Push({ CreateMove(DeltaTime), Correction.ApplyTo(GetChassisState()) });
+	++MovesSinceLastSend;
+
+	TimeSinceMovesSent += DeltaTime;
+	const float SendInterval = MoveSendRate > 0.f ? 1.f / MoveSendRate : 0.f;
+	if (TimeSinceMovesSent >= SendInterval)
+	{
+		TimeSinceMovesSent = FMath::Min(TimeSinceMovesSent - SendInterval, SendInterval);
+		SendMoves();
+	}
+}
+
+void AKrazyKartsPawn::SendMoves()
+{
+	const int32 NumToSend = FMath::Min(FMath::Max(MoveRedundancy, MovesSinceLastSend), FMath::Min(UnacknowledgedMoves.Num(), MaxMovesPerSend));
+	if (NumToSend > 0)
+	{
+		MovesToSend.Reset();
+		for (int32 Index = UnacknowledgedMoves.Num() - NumToSend; Index < UnacknowledgedMoves.Num(); ++Index)
+		{
+			MovesToSend.Add(UnacknowledgedMoves[Index].Move);
+		}
+		Server_SendMoves(MovesToSend);
+	}
+	MovesSinceLastSend = 0;
+}
+
+bool AKrazyKartsPawn::Server_SendMoves_Validate(const TArray<FKrazyKartsVehicleMove>& Moves)
+{
+	return Moves.Num() <= MaxMovesPerSend;
+}
+
+void AKrazyKartsPawn::Server_SendMoves_Implementation(const TArray<FKrazyKartsVehicleMove>& Moves)
+{
+	// PhysX steps the vehicle at the server's own frame rate, so only the newest input is applied
+	for (const FKrazyKartsVehicleMove& Move : Moves)
+	{
+		if (Move.Sequence > ReceivedMove.Sequence)
+		{
+			ReceivedMove = Move;
+		}
+	}
+	KartsVehicleMovement->SetRemoteInputs(ReceivedMove.Steering, ReceivedMove.Throttle, ReceivedMove.Brake, ReceivedMove.Handbrake, ReceivedMove.Gear);
+}
+
+void AKrazyKartsPawn::TickAuthority(float DeltaTime)
+{
+	// Physics has stepped with SimulatedMove's input since the last tick
+	ServerState.SetChassis(GetChassisState());
+	ServerState.Gear = KartsVehicleMovement->GetCurrentGear();
+	ServerState.TimeStamp = SimulatedMoveTime;
+	ServerState.LastMove = SimulatedMove;
+
+	// The component has already consumed this frame's input, which the next physics step uses. On the owner's
+	// clock that step starts when a new move was made, or carries on from the last one while no newer move is in.
+	const FKrazyKartsVehicleMove NextMove{ IsLocallyControlled() ? CreateMove(DeltaTime) : ReceivedMove };
+	const float StepStartTime = NextMove.Sequence != SimulatedMove.Sequence ? NextMove.TimeStamp : SimulatedMoveTime;
+	SimulatedMoveTime = StepStartTime + DeltaTime;
+	SimulatedMove = NextMove;
+}
+
+void AKrazyKartsPawn::OnRep_ServerState()
+{
+	if (GetLocalRole() == ROLE_SimulatedProxy)
+	{
+		Snapshots.Add(ServerState.TimeStamp, GetWorld()->GetTimeSeconds(),
+			ServerState.Location, ServerState.Rotation, ServerState.LinearVelocity / 100.f);
+		if (KartsVehicleMovement->GetCurrentGear() != ServerState.Gear)
+		{
+			KartsVehicleMovement->SetTargetGear(ServerState.Gear, true);
+		}
+	}
+	else if (GetLocalRole() == ROLE_AutonomousProxy)
+	{
+		ReconcileWithServer();
+	}
+}
+
+void AKrazyKartsPawn::ReconcileWithServer()
+{
+	SCOPE_CYCLE_COUNTER(STAT_KrazyKartsPawnReconcile);
+	CSV_SCOPED_TIMING_STAT(KrazyKarts, PawnReconcile);
+
+	if (UnacknowledgedMoves.IsEmpty())
+	{
+		return;
+	}
+
+	// The server steps PhysX at its own rate with only the newest input, so the state it sends after a move is not
+	// the one predicted for that move. Match it to the prediction at the same time on this client's clock instead.
+	const float ServerTime = ServerState.TimeStamp;
+	int32 NumPassed = 0;
+	while (NumPassed + 1 < UnacknowledgedMoves.Num() && UnacknowledgedMoves[NumPassed + 1].Move.TimeStamp <= ServerTime)
+	{
+		++NumPassed;
+	}
+	UnacknowledgedMoves.PopFront(NumPassed);
+
+	// Keep the move before the server state to interpolate from; the state may also be older than the history
+	// or newer than anything predicted yet
+	if (UnacknowledgedMoves.Num() < 2 || UnacknowledgedMoves[0].Move.TimeStamp > ServerTime)
+	{
+		return;
+	}
+	const FKrazyKartsPendingVehicleMove& Before = UnacknowledgedMoves[0];
+	const FKrazyKartsPendingVehicleMove& After = UnacknowledgedMoves[1];
+	const float Alpha = (ServerTime - Before.Move.TimeStamp) / FMath::Max(After.Move.TimeStamp - Before.Move.TimeStamp, KINDA_SMALL_NUMBER);
+	const FKrazyKartsChassisState Predicted{ Interpolate(Before.PredictedState, After.PredictedState, FMath::Clamp(Alpha, 0.f, 1.f)) };
+
+	const FKrazyKartsChassisState Server{ ServerState.GetChassis() };
+	if (IsWithinErrorThreshold(Predicted, Server))
+	{
+		return;
+	}
+
+	// PhysX cannot replay a single vehicle, so instead of snapping back to the server state and losing the
+	// round trip, carry the error at that time over to the predictions and to where the chassis is heading,
+	// including any correction not blended in yet
+	for (int32 Index = 0; Index < UnacknowledgedMoves.Num(); ++Index)
+	{
+		FKrazyKartsChassisState& PendingState = UnacknowledgedMoves[Index].PredictedState;
+		PendingState = Rebase(PendingState, Predicted, Server);
+	}
+
+	const FKrazyKartsChassisState Current{ GetChassisState() };
+	const FKrazyKartsChassisState Target{ Rebase(Correction.ApplyTo(Current), Predicted, Server) };
+	if (CorrectionBlendTime <= 0.f || FVector::DistSquared(Current.Location, Target.Location) > FMath::Square(MaxBlendedLocationError))
+	{
+		SetChassisState(Target);
+		Correction = FKrazyKartsChassisCorrection();
+		CorrectionTimeRemaining = 0.f;
+	}
+	else
+	{
+		Correction = FKrazyKartsChassisCorrection::Between(Current, Target);
+		CorrectionTimeRemaining = CorrectionBlendTime;
+	}
+
+	if (KartsVehicleMovement->GetCurrentGear() != ServerState.Gear)
+	{
+		KartsVehicleMovement->SetTargetGear(ServerState.Gear, true);
+	}
+}
+
+void AKrazyKartsPawn::BlendCorrection(float DeltaTime)
+{
+	if (CorrectionTimeRemaining <= 0.f)
+	{
+		return;
+	}
+
+	// Move the chassis a share of the way each frame, so the whole correction is in after CorrectionBlendTime
+	const float Fraction = DeltaTime >= CorrectionTimeRemaining ? 1.f : DeltaTime / CorrectionTimeRemaining;
+	SetChassisState(Correction.ApplyTo(GetChassisState(), Fraction));
+	Correction = Fraction < 1.f ? Correction.GetRemainder(Fraction) : FKrazyKartsChassisCorrection();
+	CorrectionTimeRemaining = Fraction < 1.f ? CorrectionTimeRemaining - DeltaTime : 0.f;
+}
+
+bool AKrazyKartsPawn::IsWithinErrorThreshold(const FKrazyKartsChassisState& Predicted, const FKrazyKartsChassisState& Server) const
+{
+	// Being MaxTimingError early or late on the server's timeline moves the chassis this far at its current speed
+	const float LocationError = MaxLocationError + Server.LinearVelocity.Size() * MaxTimingError;
+	const float RotationError = MaxRotationError + FMath::DegreesToRadians(Server.AngularVelocity.Size()) * MaxTimingError;
+	return FVector::DistSquared(Predicted.Location, Server.Location) <= FMath::Square(LocationError)
+		&& FVector::DistSquared(Predicted.LinearVelocity, Server.LinearVelocity) <= FMath::Square(MaxVelocityError)
+		&& Predicted.Rotation.AngularDistance(Server.Rotation) <= RotationError;
+}
+
+void AKrazyKartsPawn::InterpolateSnapshots()
+{
+	const float UpdateInterval = Snapshots.GetAverageInterval() > 0.f ? Snapshots.GetAverageInterval() : 1.f / FMath::Max(NetUpdateFrequency, 1.f);
+	const float Delay = SnapshotInterpolationDelay > 0.f ? SnapshotInterpolationDelay : 1.5f * UpdateInterval;
+
+	FVector Location;
+	FQuat Rotation;
+	if (Snapshots.Sample(GetWorld()->GetTimeSeconds(), Delay, Location, Rotation))
+	{
+		// Keep the body's velocity and the server's engine and wheel spin so wheels and suspension still look
+		// driven between teleports
+		FKrazyKartsChassisState State{ ServerState.GetChassis() };
+		State.Location = Location;
+		State.Rotation = Rotation;
+		SetChassisState(State);
+	}
+}
+
+FKrazyKartsChassisState AKrazyKartsPawn::GetChassisState() const
+{
+	USkeletalMeshComponent* Chassis = GetMesh();
+	FKrazyKartsChassisState State;
+	State.Location = Chassis->GetComponentLocation();
+	State.Rotation = Chassis->GetComponentQuat();
+	State.LinearVelocity = Chassis->GetPhysicsLinearVelocity();
+	State.AngularVelocity = Chassis->GetPhysicsAngularVelocityInDegrees();
+	KartsVehicleMovement->GetDrivetrainState(State.EngineRPM, MakeArrayView(State.WheelRotationSpeeds));
+	return State;
+}
+
+void AKrazyKartsPawn::SetChassisState(const FKrazyKartsChassisState& State)
+{
+	USkeletalMeshComponent* Chassis = GetMesh();
+	Chassis->SetWorldLocationAndRotation(State.Location, State.Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	if (Chassis->IsSimulatingPhysics())
+	{
+		Chassis->SetPhysicsLinearVelocity(State.LinearVelocity);
+		Chassis->SetPhysicsAngularVelocityInDegrees(State.AngularVelocity);
+	}
+
+	// Otherwise the engine and wheels keep spinning at the old speed and drag the chassis back towards it
+	KartsVehicleMovement->SetDrivetrainState(State.EngineRPM, MakeArrayView(State.WheelRotationSpeeds));
+}
+
 #undef LOCTEXT_NAMESPACE
 
 PRAGMA_ENABLE_DEPRECATION_WARNINGS
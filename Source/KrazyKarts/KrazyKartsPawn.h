@@ -4,12 +4,17 @@
 
 #include "CoreMinimal.h"
 #include "WheeledVehicle.h"
+#include "GoKartRingBuffer.h"
+#include "GoKartSnapshotBuffer.h"
+#include "KrazyKartsVehicleNet.h"
+#include "KrazyKartsVehicleManager.h"
 #include "KrazyKartsPawn.generated.h"
 
 class UCameraComponent;
 class USpringArmComponent;
 class UTextRenderComponent;
 class UInputComponent;
+class UKrazyKartsVehicleMovement;
 
 PRAGMA_DISABLE_DEPRECATION_WARNINGS
 
@@ -44,7 +49,7 @@ class AKrazyKartsPawn : public AWheeledVehicle
 
 	
 public:
-	AKrazyKartsPawn();
+	AKrazyKartsPawn(const FObjectInitializer& ObjectInitializer);
 
 	/** The current speed as a string eg 10 km/h */
 	UPROPERTY(Category = Display, VisibleDefaultsOnly, BlueprintReadOnly)
@@ -80,6 +85,8 @@ public:
 	virtual void Tick(float Delta) override;
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void PostInitializeComponents() override;
 
 public:
 	// End Actor interface
@@ -102,6 +109,16 @@ public:
 	/** Handle reset VR device */
 	void OnResetVR();
 
+	/** Controlled or viewed by a player, so always simulated in full */
+	bool IsPlayerVehicle() const;
+
+	/** Apply the simulation tier picked by UKrazyKartsVehicleManager */
+	void SetVehicleLOD(EKrazyKartsVehicleLOD NewLOD);
+	EKrazyKartsVehicleLOD GetVehicleLOD() const { return VehicleLOD; }
+
+	/** Seconds between pawn and animation updates, 0 for every frame, and whether to animate while off screen */
+	void SetUpdateInterval(float Interval, bool bAnimateOffscreen);
+
 	static const FName LookUpBinding;
 	static const FName LookRightBinding;
 
@@ -114,12 +131,110 @@ private:
 	 */
 	void EnableIncarView( const bool bState, const bool bForce = false );
 
-	/** Update the gear and speed strings */
-	void UpdateHUDStrings();
+	/** Update the gear and speed strings, returns true if either changed */
+	bool UpdateHUDStrings();
+
+	/** Is this pawn possessed or watched by a player on this machine */
+	bool IsLocallyViewed() const;
+
+	/** Speed and gear the display strings were last built for */
+	int32 DisplayedSpeed;
+	int32 DisplayedGear;
 
 	/* Are we on a 'slippery' surface */
 	bool bIsLowFriction;
 
+	/** Moves per second sent by the owning client, 0 sends every frame */
+	UPROPERTY(Category = Network, EditAnywhere)
+	float MoveSendRate;
+
+	/** Most recent moves repeated in every send, so a lost packet is covered by the next one */
+	UPROPERTY(Category = Network, EditAnywhere)
+	int32 MoveRedundancy;
+
+	/** Moves kept for reconciliation while the server does not acknowledge them */
+	UPROPERTY(Category = Network, EditAnywhere)
+	int32 MaxUnacknowledgedMoves;
+
+	/** Prediction errors up to these are left uncorrected (cm, cm/s, radians) */
+	UPROPERTY(Category = Network, EditAnywhere)
+	float MaxLocationError;
+	UPROPERTY(Category = Network, EditAnywhere)
+	float MaxVelocityError;
+	UPROPERTY(Category = Network, EditAnywhere)
+	float MaxRotationError;
+
+	/**
+	 * Seconds the server's state can be off the owning client's timeline. The server steps PhysX at its own
+	 * frame rate with the newest input it has, so this is about one server frame plus one client frame.
+	 * Widens the location and rotation thresholds by the distance and angle covered in that time.
+	 */
+	UPROPERTY(Category = Network, EditAnywhere)
+	float MaxTimingError;
+
+	/** Seconds a correction is blended in over, 0 applies it at once */
+	UPROPERTY(Category = Network, EditAnywhere)
+	float CorrectionBlendTime;
+
+	/** Corrections moving the chassis further than this (cm) are applied at once */
+	UPROPERTY(Category = Network, EditAnywhere)
+	float MaxBlendedLocationError;
+
+	/** Seconds remote vehicles are drawn behind the newest server state, 0 uses 1.5 received update intervals */
+	UPROPERTY(Category = Network, EditAnywhere)
+	float SnapshotInterpolationDelay;
+
+	UPROPERTY(Transient)
+	UKrazyKartsVehicleMovement* KartsVehicleMovement;
+
+	/** Authoritative chassis, engine and wheel spin, gear and the last move simulated, replicated instead of the stock movement */
+	UPROPERTY(ReplicatedUsing = OnRep_ServerState)
+	FKrazyKartsVehicleState ServerState;
+
+	UFUNCTION()
+	void OnRep_ServerState();
+
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void Server_SendMoves(const TArray<FKrazyKartsVehicleMove>& Moves);
+
+	/** Owning client: moves sent but not yet passed by a server state, with the chassis predicted when each was made */
+	TGoKartRingBuffer<FKrazyKartsPendingVehicleMove> UnacknowledgedMoves;
+	TArray<FKrazyKartsVehicleMove> MovesToSend;
+	uint32 NextMoveSequence;
+	float TimeSinceMovesSent;
+	int32 MovesSinceLastSend;
+	float DeltaTimeRemainder;
+
+	/** Owning client: correction still to be blended into the chassis, and over how many more seconds */
+	FKrazyKartsChassisCorrection Correction;
+	float CorrectionTimeRemaining;
+
+	/** Server: newest move received, and the move whose input the last physics step used */
+	FKrazyKartsVehicleMove ReceivedMove;
+	FKrazyKartsVehicleMove SimulatedMove;
+
+	/** Server: owning client's clock at the end of the physics step now running */
+	float SimulatedMoveTime;
+
+	/** Simulated proxies: server states to interpolate between */
+	FGoKartSnapshotBuffer Snapshots;
+
+	FKrazyKartsVehicleMove CreateMove(float DeltaTime);
+	void TickAutonomousProxy(float DeltaTime);
+	void TickAuthority(float DeltaTime);
+	void SendMoves();
+	void ReconcileWithServer();
+	void BlendCorrection(float DeltaTime);
+	void InterpolateSnapshots();
+
+	FKrazyKartsChassisState GetChassisState() const;
+	void SetChassisState(const FKrazyKartsChassisState& State);
+	bool IsWithinErrorThreshold(const FKrazyKartsChassisState& Predicted, const FKrazyKartsChassisState& Server) const;
+
+	UPROPERTY(Transient)
+	UKrazyKartsVehicleManager* VehicleManager;
+
+	EKrazyKartsVehicleLOD VehicleLOD;
 
 public:
 	/** Returns SpringArm subobject **/
@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "KrazyKartsServerStats.h"
+
+#include "KrazyKarts.h"
+#include "GoKart.h"
+#include "EngineUtils.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+
+namespace
+{
+	TAutoConsoleVariable<float> CVarServerStatsPeriod(
+		TEXT("kk.Server.StatsPeriod"),
+		10.f,
+		TEXT("Seconds between dedicated server performance logs, 0 disables them."));
+}
+
+bool UKrazyKartsServerStats::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && IsRunningDedicatedServer();
+}
+
+void UKrazyKartsServerStats::AddSimulateCost(uint64 Cycles, int32 NumMoves)
+{
+	SimulateCycles += Cycles;
+	NumSimulatedMoves += NumMoves;
+}
+
+bool UKrazyKartsServerStats::IsTickable() const
+{
+	return !IsTemplate() && CVarServerStatsPeriod.GetValueOnGameThread() > 0.f;
+}
+
+TStatId UKrazyKartsServerStats::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UKrazyKartsServerStats, STATGROUP_Tickables);
+}
+
+void UKrazyKartsServerStats::Tick(float DeltaTime)
+{
+	// Servers sleep to hold their tick rate, so the idle part of the frame isn't work
+	const double TickTime = FMath::Max(FApp::GetDeltaTime() - FApp::GetIdleTime(), 0.0);
+	TotalTickTime += TickTime;
+	MaxTickTime = FMath::Max(MaxTickTime, TickTime);
+	++NumFrames;
+
+	const double CurrentTime = FPlatformTime::Seconds();
+	if (PeriodStartTime == 0.0)
+	{
+		PeriodStartTime = CurrentTime;
+	}
+	else if (CurrentTime - PeriodStartTime >= CVarServerStatsPeriod.GetValueOnGameThread())
+	{
+		Report(CurrentTime - PeriodStartTime);
+		PeriodStartTime = CurrentTime;
+	}
+}
+
+void UKrazyKartsServerStats::Report(double Elapsed)
+{
+	UWorld* World = GetWorld();
+
+	// Each client picks its own send rate, see FGoKartSendRateController
+	int32 NumKarts = 0;
+	int32 NumSendingKarts = 0;
+	double SumSendRate = 0.0;
+	double MinSendRate = 0.0;
+	double MaxSendRate = 0.0;
+	int32 MaxQueueDepth = 0;
+	int32 NumDroppedMoves = 0;
+	int32 NumClampedMoves = 0;
+	for (TActorIterator<AGoKart> It(World); It; ++It)
+	{
+		++NumKarts;
+		if (It->GetRemoteRole() == ROLE_AutonomousProxy)
+		{
+			const double SendRate = It->GetNumMoveSendsReceived() / Elapsed;
+			MinSendRate = NumSendingKarts > 0 ? FMath::Min(MinSendRate, SendRate) : SendRate;
+			MaxSendRate = FMath::Max(MaxSendRate, SendRate);
+			SumSendRate += SendRate;
+			++NumSendingKarts;
+			UE_LOG(LogKrazyKarts, Verbose, TEXT("Server: %s %s sends moves at %.1f Hz, queue max %d, dropped %d, clamped %d"),
+				*It->GetName(), It->GetNetConnection() ? *It->GetNetConnection()->LowLevelGetRemoteAddress(true) : TEXT("?"), SendRate,
+				It->GetMaxServerMoveQueueDepth(), It->GetNumDroppedServerMoves(), It->GetNumClampedServerMoves());
+		}
+		MaxQueueDepth = FMath::Max(MaxQueueDepth, It->GetMaxServerMoveQueueDepth());
+		NumDroppedMoves += It->GetNumDroppedServerMoves();
+		NumClampedMoves += It->GetNumClampedServerMoves();
+		It->ResetServerMoveStats();
+	}
+
+	const UNetDriver* NetDriver = World->GetNetDriver();
+	const int32 NumConnections = NetDriver ? NetDriver->ClientConnections.Num() : 0;
+
+	const double SimulateMs = FPlatformTime::ToMilliseconds64(SimulateCycles);
+	const double FrameMs = NumFrames > 0 ? TotalTickTime * 1000.0 / NumFrames : 0.0;
+	const double MoveUs = NumSimulatedMoves > 0 ? SimulateMs * 1000.0 / NumSimulatedMoves : 0.0;
+	const double KartMsPerFrame = NumFrames > 0 && NumKarts > 0 ? SimulateMs / NumFrames / NumKarts : 0.0;
+
+	UE_LOG(LogKrazyKarts, Display, TEXT("Server: tick %.2f ms avg %.2f ms max, %d karts, %d connections, simulate %.2f us/move %.4f ms/kart/frame (%d moves), client sends %.1f/%.1f/%.1f Hz min/avg/max, move queue max %d, dropped %d, clamped %d"),
+		FrameMs, MaxTickTime * 1000.0, NumKarts, NumConnections, MoveUs, KartMsPerFrame, NumSimulatedMoves,
+		MinSendRate, NumSendingKarts > 0 ? SumSendRate / NumSendingKarts : 0.0, MaxSendRate, MaxQueueDepth, NumDroppedMoves, NumClampedMoves);
+
+	NumFrames = 0;
+	TotalTickTime = 0.0;
+	MaxTickTime = 0.0;
+	SimulateCycles = 0;
+	NumSimulatedMoves = 0;
+}
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "KrazyKartsServerStats.generated.h"
+
+/**
+ * Dedicated server only. Periodically logs game thread tick time, the cost of simulating
+ * kart moves, the connection count, the rate clients send their moves at and how their
+ * move queues fared, for sizing how many karts one server core holds. Per client numbers
+ * are logged at Verbose.
+ * The period is set with kk.Server.StatsPeriod (seconds, 0 disables).
+ */
+UCLASS()
+class UKrazyKartsServerStats : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	// Called with the time spent simulating server-side kart moves
+	void AddSimulateCost(uint64 Cycles, int32 NumMoves = 1);
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+private:
+	void Report(double Elapsed);
+
+	double PeriodStartTime{};
+	int32 NumFrames{};
+	double TotalTickTime{};
+	double MaxTickTime{};
+	uint64 SimulateCycles{};
+	int32 NumSimulatedMoves{};
+};
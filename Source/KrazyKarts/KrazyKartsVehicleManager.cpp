@@ -0,0 +1,223 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "KrazyKartsVehicleManager.h"
+
+#include "KrazyKarts.h"
+#include "KrazyKartsPawn.h"
+#include "Algo/StableSort.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+PRAGMA_DISABLE_DEPRECATION_WARNINGS
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarVehicleLOD(
+		TEXT("kk.Vehicle.LOD"),
+		1,
+		TEXT("Reduce the physics of distant vehicles: fewer sub-steps and simple tires in the mid range, no physics far away."));
+
+	TAutoConsoleVariable<int32> CVarVehicleUpdateBudget(
+		TEXT("kk.Vehicle.UpdateBudget"),
+		1,
+		TEXT("Update remote vehicles' pawn and animation less often so they fit in UpdateBudgetMs, and stop animating them off screen."));
+
+	// Seconds since a vehicle was last rendered for it to still count as on screen
+	constexpr float OnScreenTime = 0.2f;
+
+	// Weight of the newest frame in the per vehicle update cost
+	constexpr float UpdateCostSmoothing = 0.1f;
+}
+
+DECLARE_CYCLE_STAT(TEXT("Vehicle LOD"), STAT_KrazyKartsVehicleLOD, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Full Vehicles"), STAT_KrazyKartsFullVehicles, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Reduced Vehicles"), STAT_KrazyKartsReducedVehicles, STATGROUP_KrazyKarts);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Kinematic Vehicles"), STAT_KrazyKartsKinematicVehicles, STATGROUP_KrazyKarts);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Vehicle Update Time (ms)"), STAT_KrazyKartsVehicleUpdateTime, STATGROUP_KrazyKarts);
+
+bool UKrazyKartsVehicleManager::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+bool UKrazyKartsVehicleManager::IsTickable() const
+{
+	return !IsTemplate() && Vehicles.Num() > 0;
+}
+
+TStatId UKrazyKartsVehicleManager::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UKrazyKartsVehicleManager, STATGROUP_Tickables);
+}
+
+void UKrazyKartsVehicleManager::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KrazyKartsVehicleLOD);
+
+	UpdateViewLocations();
+
+	int32 NumPlayerVehicles = 0;
+	SortedVehicles.Reset();
+	for (AKrazyKartsPawn* Vehicle : Vehicles)
+	{
+		if (Vehicle->IsPlayerVehicle())
+		{
+			Vehicle->SetVehicleLOD(EKrazyKartsVehicleLOD::Full);
+			Vehicle->SetUpdateInterval(0.f, true);
+			++NumPlayerVehicles;
+			continue;
+		}
+
+		float DistanceSquared = MAX_flt;
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			DistanceSquared = FMath::Min(DistanceSquared, FVector::DistSquared(ViewLocation, Vehicle->GetActorLocation()));
+		}
+		SortedVehicles.Add({ Vehicle, DistanceSquared, Vehicle->GetMesh()->WasRecentlyRendered(OnScreenTime) });
+	}
+
+	// Nearest vehicles get the budgets first
+	SortedVehicles.Sort([](const FVehicleDistance& A, const FVehicleDistance& B)
+	{
+		return A.DistanceSquared < B.DistanceSquared;
+	});
+
+	AssignLODs(NumPlayerVehicles);
+	if (!IsRunningDedicatedServer())
+	{
+		DistributeUpdateBudget(DeltaTime, NumPlayerVehicles);
+	}
+}
+
+void UKrazyKartsVehicleManager::AssignLODs(int32 NumPlayerVehicles)
+{
+	const bool bEnabled = CVarVehicleLOD.GetValueOnGameThread() != 0;
+	int32 NumFull = NumPlayerVehicles;
+	int32 NumReduced = 0;
+	for (const FVehicleDistance& Entry : SortedVehicles)
+	{
+		EKrazyKartsVehicleLOD LOD = bEnabled ? GetLODForDistance(*Entry.Vehicle, Entry.DistanceSquared) : EKrazyKartsVehicleLOD::Full;
+		if (bEnabled && LOD == EKrazyKartsVehicleLOD::Full && NumFull >= MaxFullVehicles)
+		{
+			LOD = EKrazyKartsVehicleLOD::Reduced;
+		}
+		if (bEnabled && LOD == EKrazyKartsVehicleLOD::Reduced && NumReduced >= MaxReducedVehicles)
+		{
+			LOD = EKrazyKartsVehicleLOD::Kinematic;
+		}
+
+		// Nothing would move a vehicle this machine is the authority for
+		if (LOD == EKrazyKartsVehicleLOD::Kinematic && Entry.Vehicle->HasAuthority())
+		{
+			LOD = EKrazyKartsVehicleLOD::Reduced;
+		}
+
+		NumFull += LOD == EKrazyKartsVehicleLOD::Full;
+		NumReduced += LOD == EKrazyKartsVehicleLOD::Reduced;
+		Entry.Vehicle->SetVehicleLOD(LOD);
+	}
+
+	SET_DWORD_STAT(STAT_KrazyKartsFullVehicles, NumFull);
+	SET_DWORD_STAT(STAT_KrazyKartsReducedVehicles, NumReduced);
+	SET_DWORD_STAT(STAT_KrazyKartsKinematicVehicles, Vehicles.Num() - NumFull - NumReduced);
+}
+
+void UKrazyKartsVehicleManager::AddUpdateCost(uint32 Cycles, bool bAnimationUpdate)
+{
+	FrameUpdateCycles += Cycles;
+	NumFrameAnimationUpdates += bAnimationUpdate;
+}
+
+void UKrazyKartsVehicleManager::DistributeUpdateBudget(float DeltaTime, int32 NumPlayerVehicles)
+{
+	// Pawn and animation time of one vehicle updated in one frame, from what the updates last frame cost
+	if (NumFrameAnimationUpdates > 0)
+	{
+		const float FrameCostMs = FPlatformTime::ToMilliseconds(FrameUpdateCycles) / NumFrameAnimationUpdates;
+		UpdateCostMs = UpdateCostMs > 0.f ? FMath::Lerp(UpdateCostMs, FrameCostMs, UpdateCostSmoothing) : FrameCostMs;
+	}
+	SET_FLOAT_STAT(STAT_KrazyKartsVehicleUpdateTime, FPlatformTime::ToMilliseconds(FrameUpdateCycles));
+	FrameUpdateCycles = 0;
+	NumFrameAnimationUpdates = 0;
+
+	if (CVarVehicleUpdateBudget.GetValueOnGameThread() == 0 || UpdateCostMs <= 0.f)
+	{
+		for (const FVehicleDistance& Entry : SortedVehicles)
+		{
+			Entry.Vehicle->SetUpdateInterval(0.f, true);
+		}
+		return;
+	}
+
+	// On screen before off screen, then nearest first
+	Algo::StableSortBy(SortedVehicles, [](const FVehicleDistance& Entry) { return !Entry.bOnScreen; });
+
+	// Every vehicle keeps its slowest rate, whatever the budget has left speeds up the most significant ones
+	float RemainingMs = UpdateBudgetMs - NumPlayerVehicles * UpdateCostMs;
+	for (const FVehicleDistance& Entry : SortedVehicles)
+	{
+		RemainingMs -= UpdateCostMs / GetMaxUpdateInterval(Entry);
+	}
+
+	for (const FVehicleDistance& Entry : SortedVehicles)
+	{
+		const int32 MaxInterval = GetMaxUpdateInterval(Entry);
+		const float ReservedMs = UpdateCostMs / MaxInterval;
+		const float AvailableMs = RemainingMs + ReservedMs;
+		const int32 Interval = AvailableMs > 0.f ? FMath::Clamp(FMath::CeilToInt(UpdateCostMs / AvailableMs), 1, MaxInterval) : MaxInterval;
+		RemainingMs -= UpdateCostMs / Interval - ReservedMs;
+
+		// Half a frame short, so a slightly long frame doesn't push the update one more frame out
+		Entry.Vehicle->SetUpdateInterval(Interval > 1 ? (Interval - 0.5f) * DeltaTime : 0.f, false);
+	}
+}
+
+int32 UKrazyKartsVehicleManager::GetMaxUpdateInterval(const FVehicleDistance& Entry) const
+{
+	return FMath::Max(Entry.bOnScreen ? MaxUpdateIntervalFrames : OffscreenUpdateIntervalFrames, 1);
+}
+
+void UKrazyKartsVehicleManager::UpdateViewLocations()
+{
+	// Local players on a client, every player on the server
+	ViewLocations.Reset();
+	for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		if (const APlayerController* PlayerController = Iterator->Get())
+		{
+			FVector Location;
+			FRotator Rotation;
+			PlayerController->GetPlayerViewPoint(Location, Rotation);
+			ViewLocations.Add(Location);
+		}
+	}
+}
+
+EKrazyKartsVehicleLOD UKrazyKartsVehicleManager::GetLODForDistance(const AKrazyKartsPawn& Vehicle, float DistanceSquared) const
+{
+	// Stretch the boundary of the tier the vehicle is in, so it has to move clearly past it to change
+	const EKrazyKartsVehicleLOD Current = Vehicle.GetVehicleLOD();
+	const float Stretch = 1.f + HysteresisFraction;
+	const float FullLimit = FullDistance * (Current == EKrazyKartsVehicleLOD::Full ? Stretch : 1.f);
+	const float ReducedLimit = ReducedDistance * (Current != EKrazyKartsVehicleLOD::Kinematic ? Stretch : 1.f);
+
+	if (DistanceSquared < FMath::Square(FullLimit))
+	{
+		return EKrazyKartsVehicleLOD::Full;
+	}
+	return DistanceSquared < FMath::Square(ReducedLimit) ? EKrazyKartsVehicleLOD::Reduced : EKrazyKartsVehicleLOD::Kinematic;
+}
+
+void UKrazyKartsVehicleManager::Register(AKrazyKartsPawn* Vehicle)
+{
+	Vehicles.AddUnique(Vehicle);
+}
+
+void UKrazyKartsVehicleManager::Unregister(AKrazyKartsPawn* Vehicle)
+{
+	Vehicles.RemoveSingleSwap(Vehicle);
+}
+
+PRAGMA_ENABLE_DEPRECATION_WARNINGS
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "KrazyKartsVehicleManager.generated.h"
+
+class AKrazyKartsPawn;
+
+// How much of the PhysX vehicle simulation a pawn pays for
+enum class EKrazyKartsVehicleLOD : uint8
+{
+	// Setup sub-steps and the full tire model
+	Full,
+	// ReducedSubSteps and simplified tires
+	Reduced,
+	// No physics, posed from server snapshots only. Never used for a vehicle simulated on this machine.
+	Kinematic,
+};
+
+/**
+ * Keeps track of every AKrazyKartsPawn in the world and picks its simulation LOD.
+ *
+ * Every frame the vehicles are sorted by distance to the nearest player view. Vehicles
+ * controlled or viewed here are always Full, the rest are Full within FullDistance, Reduced
+ * within ReducedDistance and Kinematic beyond, until a tier's budget is used up and the next
+ * vehicles drop to the tier below. A vehicle keeps its tier until it is HysteresisFraction
+ * past the boundary, so vehicles on a boundary don't flip every frame. Vehicles the server
+ * simulates never go Kinematic. kk.Vehicle.LOD 0 keeps everything Full.
+ *
+ * On clients the other vehicles also share UpdateBudgetMs of game thread time for their pawn
+ * tick and animation, measured as they run. On screen vehicles come first, nearest first, and
+ * update every frame while the budget lasts; the rest update every few frames, down to
+ * MaxUpdateIntervalFrames, or OffscreenUpdateIntervalFrames off screen, where their wheel
+ * bones are not animated at all. kk.Vehicle.UpdateBudget 0 updates every vehicle every frame.
+ *
+ * Suspension queries are already batched: FPhysXVehicleManager gathers the wheels of every
+ * vehicle in a physics scene and raycasts them with one PxBatchQuery per substep, on the
+ * thread that steps the scene, so there is no per-vehicle path to replace. Its cost is part of
+ * the physics scene tick and falls with ReducedSubSteps and Kinematic vehicles.
+ */
+UCLASS(config=Game)
+class UKrazyKartsVehicleManager : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	void Register(AKrazyKartsPawn* Vehicle);
+	void Unregister(AKrazyKartsPawn* Vehicle);
+
+	// Game thread time spent updating a vehicle, from its pawn tick or from its animation
+	void AddUpdateCost(uint32 Cycles, bool bAnimationUpdate);
+
+	/** Distances to the nearest player view within which vehicles are Full and Reduced (cm) */
+	UPROPERTY(config)
+	float FullDistance = 5000.f;
+	UPROPERTY(config)
+	float ReducedDistance = 20000.f;
+
+	/** Fraction of a tier distance a vehicle has to pass before it leaves that tier */
+	UPROPERTY(config)
+	float HysteresisFraction = 0.1f;
+
+	/** Most vehicles in the Full and Reduced tiers, including the always Full player vehicles */
+	UPROPERTY(config)
+	int32 MaxFullVehicles = 8;
+	UPROPERTY(config)
+	int32 MaxReducedVehicles = 24;
+
+	/** PhysX sub-steps per physics step for Reduced vehicles, at any speed */
+	UPROPERTY(config)
+	int32 ReducedSubSteps = 1;
+
+	/** Client game thread ms per frame for the pawn and animation updates of vehicles, player vehicles included */
+	UPROPERTY(config)
+	float UpdateBudgetMs = 2.f;
+
+	/** Most frames between updates of a vehicle that is on and off screen */
+	UPROPERTY(config)
+	int32 MaxUpdateIntervalFrames = 4;
+	UPROPERTY(config)
+	int32 OffscreenUpdateIntervalFrames = 8;
+
+private:
+	struct FVehicleDistance
+	{
+		AKrazyKartsPawn* Vehicle;
+		float DistanceSquared;
+		bool bOnScreen;
+	};
+
+	void UpdateViewLocations();
+	void AssignLODs(int32 NumPlayerVehicles);
+	void DistributeUpdateBudget(float DeltaTime, int32 NumPlayerVehicles);
+	int32 GetMaxUpdateInterval(const FVehicleDistance& Entry) const;
+	EKrazyKartsVehicleLOD GetLODForDistance(const AKrazyKartsPawn& Vehicle, float DistanceSquared) const;
+
+	UPROPERTY()
+	TArray<AKrazyKartsPawn*> Vehicles;
+
+	// Reused every frame
+	TArray<FVector> ViewLocations;
+	TArray<FVehicleDistance> SortedVehicles;
+
+	// Update time reported since the last Tick, and the smoothed time of one vehicle update
+	uint32 FrameUpdateCycles = 0;
+	int32 NumFrameAnimationUpdates = 0;
+	float UpdateCostMs = 0.f;
+};
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "KrazyKartsVehicleMesh.h"
+
+#include "KrazyKartsVehicleManager.h"
+#include "Engine/World.h"
+
+void UKrazyKartsVehicleMesh::BeginPlay()
+{
+	Super::BeginPlay();
+
+	VehicleManager = GetWorld()->GetSubsystem<UKrazyKartsVehicleManager>();
+}
+
+void UKrazyKartsVehicleMesh::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	const uint32 StartCycles = FPlatformTime::Cycles();
+
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (VehicleManager)
+	{
+		VehicleManager->AddUpdateCost(FPlatformTime::Cycles() - StartCycles, true);
+	}
+}
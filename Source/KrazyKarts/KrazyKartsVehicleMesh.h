@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "KrazyKartsVehicleMesh.generated.h"
+
+class UKrazyKartsVehicleManager;
+
+/**
+ * Chassis mesh of AKrazyKartsPawn. Reports the game thread time of each animation update to
+ * UKrazyKartsVehicleManager, which spreads its update budget with it. With parallel animation
+ * evaluation that is the time to start the evaluation and any work that stays on the game
+ * thread, not the worker time.
+ */
+UCLASS()
+class UKrazyKartsVehicleMesh : public USkeletalMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	UPROPERTY(Transient)
+	UKrazyKartsVehicleManager* VehicleManager;
+};
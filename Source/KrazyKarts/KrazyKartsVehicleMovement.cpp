@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "KrazyKartsVehicleMovement.h"
+
+#include "VehicleWheel.h"
+#if WITH_PHYSX
+#include "PhysXPublic.h"
+#endif // WITH_PHYSX
+
+PRAGMA_DISABLE_DEPRECATION_WARNINGS
+
+UKrazyKartsVehicleMovement::UKrazyKartsVehicleMovement()
+	: bSimplifiedTires(false)
+{
+	SetIsReplicatedByDefault(false);
+}
+
+void UKrazyKartsVehicleMovement::GetInputs(float& OutSteering, float& OutThrottle, float& OutBrake, float& OutHandbrake) const
+{
+	OutSteering = SteeringInput;
+	OutThrottle = ThrottleInput;
+	OutBrake = BrakeInput;
+	OutHandbrake = HandbrakeInput;
+}
+
+void UKrazyKartsVehicleMovement::SetRemoteInputs(float InSteering, float InThrottle, float InBrake, float InHandbrake, int32 InGear)
+{
+	// UpdateState applies ReplicatedState to vehicles without a local controller
+	ReplicatedState.SteeringInput = InSteering;
+	ReplicatedState.ThrottleInput = InThrottle;
+	ReplicatedState.BrakeInput = InBrake;
+	ReplicatedState.HandbrakeInput = InHandbrake;
+	ReplicatedState.CurrentGear = InGear;
+}
+
+void UKrazyKartsVehicleMovement::SetSubStepCounts(int32 LowSpeedSubSteps, int32 HighSpeedSubSteps)
+{
+#if WITH_PHYSX
+	// Vehicles are updated on the game thread before the scene steps, so the sim data can be written from tick
+	if (PVehicle)
+	{
+		PVehicle->mWheelsSimData.setSubStepCount(ThresholdLongitudinalSpeed, FMath::Max(LowSpeedSubSteps, 1), FMath::Max(HighSpeedSubSteps, 1));
+	}
+#endif // WITH_PHYSX
+}
+
+void UKrazyKartsVehicleMovement::RestoreSubStepCounts()
+{
+	SetSubStepCounts(LowForwardSpeedSubStepCount, HighForwardSpeedSubStepCount);
+}
+
+void UKrazyKartsVehicleMovement::GetDrivetrainState(float& OutEngineRPM, TArrayView<float> OutWheelRotationSpeeds) const
+{
+	OutEngineRPM = 0.f;
+	for (float& WheelRotationSpeed : OutWheelRotationSpeeds)
+	{
+		WheelRotationSpeed = 0.f;
+	}
+
+#if WITH_PHYSX
+	if (PVehicle && PVehicleDrive)
+	{
+		OutEngineRPM = GetEngineRotationSpeed();
+		const int32 NumWheels = FMath::Min(OutWheelRotationSpeeds.Num(), int32(PVehicle->mWheelsSimData.getNbWheels()));
+		for (int32 Wheel = 0; Wheel < NumWheels; ++Wheel)
+		{
+			OutWheelRotationSpeeds[Wheel] = PVehicle->mWheelsDynData.getWheelRotationSpeed(Wheel);
+		}
+	}
+#endif // WITH_PHYSX
+}
+
+void UKrazyKartsVehicleMovement::SetDrivetrainState(float EngineRPM, TArrayView<const float> WheelRotationSpeeds)
+{
+#if WITH_PHYSX
+	// Written from the game thread before the scene steps, like the sub-step counts
+	if (PVehicle && PVehicleDrive)
+	{
+		PVehicleDrive->mDriveDynData.setEngineRotationSpeed(FMath::Max(EngineRPM, 0.f) * PI / 30.f);
+		const int32 NumWheels = FMath::Min(WheelRotationSpeeds.Num(), int32(PVehicle->mWheelsSimData.getNbWheels()));
+		for (int32 Wheel = 0; Wheel < NumWheels; ++Wheel)
+		{
+			PVehicle->mWheelsDynData.setWheelRotationSpeed(Wheel, WheelRotationSpeeds[Wheel]);
+		}
+	}
+#endif // WITH_PHYSX
+}
+
+void UKrazyKartsVehicleMovement::GenerateTireForces(UVehicleWheel* Wheel, const FTireShaderInput& Input, FTireShaderOutput& Output)
+{
+	if (!bSimplifiedTires)
+	{
+		Super::GenerateTireForces(Wheel, Input, Output);
+		return;
+	}
+
+	// Stiffness at rest load, without the load sensitivity curve or combined slip
+	float LongForce = Wheel->LongStiffValue * Input.Gravity * Input.LongSlip;
+	float LatForce = -Wheel->LatStiffValue * Input.RestTireLoad * Input.LatSlip;
+
+	const float MaxForce = Input.TireFriction * Input.TireLoad;
+	const float ForceSquared = FMath::Square(LongForce) + FMath::Square(LatForce);
+	if (ForceSquared > FMath::Square(MaxForce))
+	{
+		const float Scale = MaxForce * FMath::InvSqrt(ForceSquared);
+		LongForce *= Scale;
+		LatForce *= Scale;
+	}
+
+	Output.LongForce = LongForce;
+	Output.LatForce = LatForce;
+	Output.WheelTorque = -LongForce * Input.WheelRadius;
+}
+
+PRAGMA_ENABLE_DEPRECATION_WARNINGS
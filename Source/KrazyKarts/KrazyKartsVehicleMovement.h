@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WheeledVehicleMovementComponent4W.h"
+#include "KrazyKartsVehicleMovement.generated.h"
+
+PRAGMA_DISABLE_DEPRECATION_WARNINGS
+
+/**
+ * 4W vehicle movement for AKrazyKartsPawn, which does its own networking. The component is not
+ * replicated, so the engine's replicated input state and its ServerUpdateState RPC every tick
+ * are not sent. The pawn reads the processed inputs into its moves and, on the server, feeds
+ * the inputs of received moves back in with SetRemoteInputs.
+ */
+UCLASS()
+class UKrazyKartsVehicleMovement : public UWheeledVehicleMovementComponent4W
+{
+	GENERATED_BODY()
+
+public:
+	UKrazyKartsVehicleMovement();
+
+	// Inputs after rate limiting, as the vehicle simulation used them this frame
+	void GetInputs(float& OutSteering, float& OutThrottle, float& OutBrake, float& OutHandbrake) const;
+
+	// Drives a vehicle that is not controlled on this machine, instead of the engine's replicated state
+	void SetRemoteInputs(float InSteering, float InThrottle, float InBrake, float InHandbrake, int32 InGear);
+
+	// PhysX sub-steps per physics step below and above ThresholdLongitudinalSpeed. Restore goes back to the setup values.
+	void SetSubStepCounts(int32 LowSpeedSubSteps, int32 HighSpeedSubSteps);
+	void RestoreSubStepCounts();
+
+	// Engine speed in rpm and wheel spin in rad/s, in WheelSetups order, as PhysX integrates them alongside the chassis
+	void GetDrivetrainState(float& OutEngineRPM, TArrayView<float> OutWheelRotationSpeeds) const;
+	void SetDrivetrainState(float EngineRPM, TArrayView<const float> WheelRotationSpeeds);
+
+	// Linear tires clamped to the friction circle instead of the PhysX slip curves and camber
+	void SetSimplifiedTires(bool bSimplified) { bSimplifiedTires = bSimplified; }
+
+protected:
+	virtual void GenerateTireForces(UVehicleWheel* Wheel, const FTireShaderInput& Input, FTireShaderOutput& Output) override;
+
+private:
+	bool bSimplifiedTires;
+};
+
+PRAGMA_ENABLE_DEPRECATION_WARNINGS
@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "KrazyKartsVehicleNet.h"
+
+#include "GoKartNetSerialization.h"
+#include "Engine/NetSerialization.h"
+
+namespace
+{
+	// Gearboxes have a handful of gears either side of neutral
+	constexpr int32 GearOffset = 8;
+	constexpr uint32 GearBits = 4;
+
+	constexpr int32 MaxEngineRPM = 65535;
+
+	// Wheel spin in 0.1 rad/s steps
+	constexpr float WheelSpeedScale = 10.f;
+
+	static_assert(sizeof(FKrazyKartsVehicleState::WheelRotationSpeeds) == sizeof(float) * FKrazyKartsChassisState::NumWheels,
+		"The replicated wheels must match the predicted ones");
+
+	void SerializeVehicleMove(FKrazyKartsVehicleMove& Move, FArchive& Ar)
+	{
+		uint8 QuantizedSteering = GoKartNet::QuantizeAxis(Move.Steering);
+		uint8 QuantizedThrottle = GoKartNet::QuantizeAxis(Move.Throttle);
+		uint8 QuantizedBrake = GoKartNet::QuantizeAxis(Move.Brake);
+		uint8 QuantizedHandbrake = GoKartNet::QuantizeAxis(Move.Handbrake);
+		uint32 Gear = uint32(FMath::Clamp(Move.Gear + GearOffset, 0, (1 << GearBits) - 1));
+		uint32 DeltaTimeMs = GoKartNet::QuantizeDeltaTime(Move.DeltaTime);
+		Ar << QuantizedSteering;
+		Ar << QuantizedThrottle;
+		Ar << QuantizedBrake;
+		Ar << QuantizedHandbrake;
+		Ar.SerializeInt(Gear, 1 << GearBits);
+		Ar.SerializeIntPacked(DeltaTimeMs);
+		Ar << Move.TimeStamp;
+		Ar.SerializeIntPacked(Move.Sequence);
+
+		if (Ar.IsLoading())
+		{
+			Move.Steering = GoKartNet::DequantizeAxis(QuantizedSteering);
+			Move.Throttle = GoKartNet::DequantizeAxis(QuantizedThrottle);
+			Move.Brake = GoKartNet::DequantizeAxis(QuantizedBrake);
+			Move.Handbrake = GoKartNet::DequantizeAxis(QuantizedHandbrake);
+			Move.Gear = int32(Gear) - GearOffset;
+			Move.DeltaTime = GoKartNet::DequantizeDeltaTime(DeltaTimeMs);
+		}
+	}
+}
+
+void FKrazyKartsVehicleMove::Quantize()
+{
+	Steering = GoKartNet::DequantizeAxis(GoKartNet::QuantizeAxis(Steering));
+	Throttle = GoKartNet::DequantizeAxis(GoKartNet::QuantizeAxis(Throttle));
+	Brake = GoKartNet::DequantizeAxis(GoKartNet::QuantizeAxis(Brake));
+	Handbrake = GoKartNet::DequantizeAxis(GoKartNet::QuantizeAxis(Handbrake));
+	Gear = FMath::Clamp(Gear, -GearOffset, (1 << GearBits) - 1 - GearOffset);
+	DeltaTime = GoKartNet::DequantizeDeltaTime(GoKartNet::QuantizeDeltaTime(DeltaTime));
+}
+
+bool FKrazyKartsVehicleMove::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	SerializeVehicleMove(*this, Ar);
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+bool FKrazyKartsVehicleState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	// mm precision for location, mm/s for linear and 0.1 deg/s for angular velocity
+	bOutSuccess = SerializePackedVector<10, 24>(Location, Ar);
+	bOutSuccess &= SerializePackedVector<10, 24>(LinearVelocity, Ar);
+	bOutSuccess &= SerializePackedVector<10, 20>(AngularVelocity, Ar);
+	GoKartNet::SerializeCompressedQuat(Rotation, Ar);
+
+	uint16 QuantizedRPM = uint16(FMath::Clamp(FMath::RoundToInt(EngineRPM), 0, MaxEngineRPM));
+	Ar << QuantizedRPM;
+	for (float& WheelRotationSpeed : WheelRotationSpeeds)
+	{
+		int16 QuantizedSpeed = int16(FMath::Clamp(FMath::RoundToInt(WheelRotationSpeed * WheelSpeedScale), int32(MIN_int16), int32(MAX_int16)));
+		Ar << QuantizedSpeed;
+		if (Ar.IsLoading())
+		{
+			WheelRotationSpeed = QuantizedSpeed / WheelSpeedScale;
+		}
+	}
+
+	uint32 QuantizedGear = uint32(FMath::Clamp(Gear + GearOffset, 0, (1 << GearBits) - 1));
+	Ar.SerializeInt(QuantizedGear, 1 << GearBits);
+
+	Ar << TimeStamp;
+	SerializeVehicleMove(LastMove, Ar);
+
+	if (Ar.IsLoading())
+	{
+		EngineRPM = QuantizedRPM;
+		Gear = int32(QuantizedGear) - GearOffset;
+	}
+
+	bOutSuccess &= !Ar.IsError();
+	return true;
+}
+
+FKrazyKartsChassisState FKrazyKartsVehicleState::GetChassis() const
+{
+	FKrazyKartsChassisState Chassis;
+	Chassis.Location = Location;
+	Chassis.Rotation = Rotation;
+	Chassis.LinearVelocity = LinearVelocity;
+	Chassis.AngularVelocity = AngularVelocity;
+	Chassis.EngineRPM = EngineRPM;
+	for (int32 Wheel = 0; Wheel < FKrazyKartsChassisState::NumWheels; ++Wheel)
+	{
+		Chassis.WheelRotationSpeeds[Wheel] = WheelRotationSpeeds[Wheel];
+	}
+	return Chassis;
+}
+
+void FKrazyKartsVehicleState::SetChassis(const FKrazyKartsChassisState& Chassis)
+{
+	Location = Chassis.Location;
+	Rotation = Chassis.Rotation;
+	LinearVelocity = Chassis.LinearVelocity;
+	AngularVelocity = Chassis.AngularVelocity;
+	EngineRPM = Chassis.EngineRPM;
+	for (int32 Wheel = 0; Wheel < FKrazyKartsChassisState::NumWheels; ++Wheel)
+	{
+		WheelRotationSpeeds[Wheel] = Chassis.WheelRotationSpeeds[Wheel];
+	}
+}
+
+FKrazyKartsChassisCorrection FKrazyKartsChassisCorrection::Between(const FKrazyKartsChassisState& From, const FKrazyKartsChassisState& To)
+{
+	FKrazyKartsChassisCorrection Correction;
+	Correction.Location = To.Location - From.Location;
+	Correction.Rotation = (To.Rotation * From.Rotation.Inverse()).GetNormalized();
+	Correction.LinearVelocity = To.LinearVelocity - From.LinearVelocity;
+	Correction.AngularVelocity = To.AngularVelocity - From.AngularVelocity;
+	Correction.EngineRPM = To.EngineRPM - From.EngineRPM;
+	for (int32 Wheel = 0; Wheel < FKrazyKartsChassisState::NumWheels; ++Wheel)
+	{
+		Correction.WheelRotationSpeeds[Wheel] = To.WheelRotationSpeeds[Wheel] - From.WheelRotationSpeeds[Wheel];
+	}
+	return Correction;
+}
+
+FKrazyKartsChassisState FKrazyKartsChassisCorrection::ApplyTo(const FKrazyKartsChassisState& State, float Fraction) const
+{
+	FKrazyKartsChassisState Result;
+	Result.Location = State.Location + Location * Fraction;
+	Result.Rotation = (FQuat::Slerp(FQuat::Identity, Rotation, Fraction) * State.Rotation).GetNormalized();
+	Result.LinearVelocity = State.LinearVelocity + LinearVelocity * Fraction;
+	Result.AngularVelocity = State.AngularVelocity + AngularVelocity * Fraction;
+	Result.EngineRPM = State.EngineRPM + EngineRPM * Fraction;
+	for (int32 Wheel = 0; Wheel < FKrazyKartsChassisState::NumWheels; ++Wheel)
+	{
+		Result.WheelRotationSpeeds[Wheel] = State.WheelRotationSpeeds[Wheel] + WheelRotationSpeeds[Wheel] * Fraction;
+	}
+	return Result;
+}
+
+FKrazyKartsChassisCorrection FKrazyKartsChassisCorrection::GetRemainder(float Fraction) const
+{
+	// Both parts of the rotation share its axis, so they compose back into the whole
+	const float Remaining = 1.f - Fraction;
+	FKrazyKartsChassisCorrection Remainder;
+	Remainder.Location = Location * Remaining;
+	Remainder.Rotation = FQuat::Slerp(FQuat::Identity, Rotation, Remaining);
+	Remainder.LinearVelocity = LinearVelocity * Remaining;
+	Remainder.AngularVelocity = AngularVelocity * Remaining;
+	Remainder.EngineRPM = EngineRPM * Remaining;
+	for (int32 Wheel = 0; Wheel < FKrazyKartsChassisState::NumWheels; ++Wheel)
+	{
+		Remainder.WheelRotationSpeeds[Wheel] = WheelRotationSpeeds[Wheel] * Remaining;
+	}
+	return Remainder;
+}
@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "KrazyKartsVehicleNet.generated.h"
+
+// One frame of processed vehicle input, sent by the owning client
+USTRUCT()
+struct FKrazyKartsVehicleMove
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	float Steering = 0.f;
+
+	UPROPERTY()
+	float Throttle = 0.f;
+
+	UPROPERTY()
+	float Brake = 0.f;
+
+	UPROPERTY()
+	float Handbrake = 0.f;
+
+	// Gear the client's gearbox was in, which the server follows as the stock vehicle replication did
+	UPROPERTY()
+	int32 Gear = 0;
+
+	UPROPERTY()
+	float DeltaTime = 0.f;
+
+	UPROPERTY()
+	float TimeStamp = 0.f;
+
+	// Increases by one for every move a vehicle creates, starting at 1
+	UPROPERTY()
+	uint32 Sequence = 0;
+
+	// Rounds the move to exactly what NetSerialize puts on the wire
+	void Quantize();
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FKrazyKartsVehicleMove> : public TStructOpsTypeTraitsBase2<FKrazyKartsVehicleMove>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+// Chassis rigid body state and the engine and wheel spin PhysX integrates with it, the part of a vehicle that is
+// predicted and corrected
+struct FKrazyKartsChassisState
+{
+	static constexpr int32 NumWheels = 4;
+
+	FVector Location{ FVector::ZeroVector }; // cm
+	FQuat Rotation{ FQuat::Identity };
+	FVector LinearVelocity{ FVector::ZeroVector }; // cm/s
+	FVector AngularVelocity{ FVector::ZeroVector }; // deg/s
+	float EngineRPM{};
+	float WheelRotationSpeeds[NumWheels]{}; // rad/s, in WheelSetups order
+};
+
+// Authoritative vehicle state replicated by the server
+USTRUCT()
+struct FKrazyKartsVehicleState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector Location{ FVector::ZeroVector };
+
+	UPROPERTY()
+	FQuat Rotation{ FQuat::Identity };
+
+	UPROPERTY()
+	FVector LinearVelocity{ FVector::ZeroVector };
+
+	UPROPERTY()
+	FVector AngularVelocity{ FVector::ZeroVector };
+
+	UPROPERTY()
+	float EngineRPM = 0.f;
+
+	// rad/s, in WheelSetups order
+	UPROPERTY()
+	float WheelRotationSpeeds[4];
+
+	UPROPERTY()
+	int32 Gear = 0;
+
+	// Time on the owning client's clock this state corresponds to: when it created the move being simulated,
+	// plus however long the server has simulated that move's input
+	UPROPERTY()
+	float TimeStamp = 0.f;
+
+	// Last move whose input the server had simulated when this state was taken
+	UPROPERTY()
+	FKrazyKartsVehicleMove LastMove;
+
+	FKrazyKartsVehicleState() { FMemory::Memzero(WheelRotationSpeeds); }
+
+	FKrazyKartsChassisState GetChassis() const;
+	void SetChassis(const FKrazyKartsChassisState& Chassis);
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FKrazyKartsVehicleState> : public TStructOpsTypeTraitsBase2<FKrazyKartsVehicleState>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+// A move the owning client has sent but the server has not acknowledged yet
+struct FKrazyKartsPendingVehicleMove
+{
+	FKrazyKartsVehicleMove Move;
+	FKrazyKartsChassisState PredictedState; // chassis at Move.TimeStamp, before the physics step that uses Move
+};
+
+// Difference between two chassis states, blended in over a few frames rather than teleported
+struct FKrazyKartsChassisCorrection
+{
+	FVector Location{ FVector::ZeroVector };
+	FQuat Rotation{ FQuat::Identity };
+	FVector LinearVelocity{ FVector::ZeroVector };
+	FVector AngularVelocity{ FVector::ZeroVector };
+	float EngineRPM{};
+	float WheelRotationSpeeds[FKrazyKartsChassisState::NumWheels]{};
+
+	static FKrazyKartsChassisCorrection Between(const FKrazyKartsChassisState& From, const FKrazyKartsChassisState& To);
+
+	// State moved by Fraction of the correction
+	FKrazyKartsChassisState ApplyTo(const FKrazyKartsChassisState& State, float Fraction = 1.f) const;
+
+	// What is left once Fraction of the correction has been applied
+	FKrazyKartsChassisCorrection GetRemainder(float Fraction) const;
+};